@@ -21,7 +21,19 @@ LIBRARY_OBJECT_FILES=\
 	OrangutanTime.o \
 	OrangutanSVP.o \
 	OrangutanX2.o \
+	OrangutanScheduler.o \
+	OrangutanWatchdog.o \
+	OrangutanEEPROMLog.o \
+	OrangutanStepper.o \
+	OrangutanI2CMaster.o \
+	OrangutanSoftSerial.o \
+	OrangutanSerialBus.o \
+	OrangutanCurrentMonitor.o \
+	OrangutanProfiler.o \
 	Pololu3pi.o \
+	PololuFixedMath.o \
+	PololuOdometry.o \
+	PololuPurePursuit.o \
 	PololuQTRSensors.o \
 	PololuWheelEncoders.o
 
@@ -30,12 +42,52 @@ LIBRARY = ../../libpololu_$(DEVICE).a
 $(LIBRARY): $(LIBRARY_OBJECT_FILES)
 	avr-ar rs $(LIBRARY) $(LIBRARY_OBJECT_FILES)
 
+# Optional link-time-optimized flavor of the library: "make lto" builds
+# ../../libpololu_$(DEVICE)_lto.a.  When an application is also compiled and
+# linked with -flto, the extern "C" wrappers get inlined into the C++ methods
+# they call and unused code is discarded across module boundaries.  The
+# objects are "fat", so the archive still works when linking without -flto.
+LTO_CFLAGS=$(CFLAGS) -flto -ffat-lto-objects
+LTO_AR=avr-gcc-ar
+LTO_LIBRARY = ../../libpololu_$(DEVICE)_lto.a
+LTO_OBJECT_FILES=$(addprefix lto/,$(LIBRARY_OBJECT_FILES))
+
+.PHONY: lto
+lto: $(LTO_LIBRARY)
+
+$(LTO_LIBRARY): $(LTO_OBJECT_FILES)
+	$(LTO_AR) rs $(LTO_LIBRARY) $(LTO_OBJECT_FILES)
+
+# Optional profiling flavor of the library: "make profile" builds
+# ../../libpololu_$(DEVICE)_profile.a with POLOLU_PROFILE defined, so the
+# library's own PROFILE_ sections (see OrangutanProfiler.h) are recorded.
+# Compile the application with -DPOLOLU_PROFILE too to use the macros.
+PROFILE_CFLAGS=$(CFLAGS) -DPOLOLU_PROFILE
+PROFILE_LIBRARY = ../../libpololu_$(DEVICE)_profile.a
+PROFILE_OBJECT_FILES=$(addprefix profile/,$(LIBRARY_OBJECT_FILES))
+
+.PHONY: profile
+profile: $(PROFILE_LIBRARY)
+
+$(PROFILE_LIBRARY): $(PROFILE_OBJECT_FILES)
+	avr-ar rs $(PROFILE_LIBRARY) $(PROFILE_OBJECT_FILES)
+
 .SECONDEXPANSION:
+lto/%.o:$(SRC)/$$*/%.cpp $(SRC)/$$*/%.h
+	@mkdir -p lto
+	$(CPP) $(LTO_CFLAGS) $(SRC)/$*/$< -c -o $@
+
+profile/%.o:$(SRC)/$$*/%.cpp $(SRC)/$$*/%.h
+	@mkdir -p profile
+	$(CPP) $(PROFILE_CFLAGS) $(SRC)/$*/$< -c -o $@
+
 %.o:$(SRC)/$$*/%.cpp $(SRC)/$$*/%.h
 	$(CPP) $(CFLAGS) $(SRC)/$*/$< -c -o $@
 
 clean:
 	rm -f $(LIBRARY_OBJECT_FILES) *.a *.hex *.obj
+	rm -rf lto
+	rm -rf profile
 	rm -rf examples/hex-files
 
 %.hex : %.obj
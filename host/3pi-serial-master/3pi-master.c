@@ -0,0 +1,235 @@
+/*
+ * 3pi-master - Command-line serial master for a 3pi Robot running the
+ * 3pi-serial-slave program, using the pololu3pi host library.
+ *
+ * All commands given on one command line are sent as a single pipelined
+ * batch, and their results are printed in order.  For example:
+ *
+ *   3pi-master -d /dev/ttyUSB0 signature battery line motors 60 60
+ *
+ * The "bench" command measures round-trip latency and throughput.
+ *
+ * http://www.pololu.com/docs/0J21
+ */
+
+#define _DEFAULT_SOURCE
+#include "pololu3pi.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+typedef struct result
+{
+	const char *name;
+	int kind;				// how to print the values
+	char signature[7];
+	unsigned int values[5];
+} result;
+
+#define PRINT_NOTHING	0
+#define PRINT_SIGNATURE	1
+#define PRINT_ONE		2
+#define PRINT_FIVE		3
+
+static void usage(void)
+{
+	fprintf(stderr,
+		"usage: 3pi-master [-d device] [-b baud] [-t timeout_ms] command...\n"
+		"commands:\n"
+		"  signature  raw  calibrated  line  trimpot  battery\n"
+		"  calibrate  reset-calibration  auto-calibrate\n"
+		"  motors LEFT RIGHT        (-255 to 255)\n"
+		"  pid MAX PNUM PDEN DNUM DDEN\n"
+		"  stop-pid  clear  print TEXT  goto X Y  play MELODY\n"
+		"  bench COUNT [BATCH]      (reads the battery COUNT times, BATCH per round trip)\n");
+	exit(2);
+}
+
+static int need(int argc, int i, int count)
+{
+	if (i + count >= argc)
+		usage();
+	return i + count;
+}
+
+static int bench(p3pi *p, long count, long batch)
+{
+	unsigned int millivolts;
+	long done = 0;
+
+	p3pi_reset_stats(p);
+	while (done < count)
+	{
+		long i;
+		p3pi_begin_batch(p);
+		for (i = 0; i < batch && done < count; i++, done++)
+		{
+			if (p3pi_read_battery_millivolts(p, &millivolts) < 0)
+				return -1;
+		}
+		if (p3pi_end_batch(p) < 0)
+			return -1;
+	}
+
+	const p3pi_stats *s = p3pi_get_stats(p);
+	double seconds = s->total_us / 1e6;
+	printf("commands:      %lu in %lu round trips\n", s->commands, s->batches);
+	printf("round trip:    mean %.0f us, min %lu us, max %lu us\n",
+		(double)s->total_us / s->batches, s->min_us, s->max_us);
+	printf("per command:   %.1f us\n", s->total_us / (double)s->commands);
+	printf("throughput:    %.0f commands/s, %.0f bytes/s sent, %.0f bytes/s received\n",
+		s->commands / seconds, s->bytes_sent / seconds, s->bytes_received / seconds);
+	return 0;
+}
+
+int main(int argc, char **argv)
+{
+	const char *device = "/dev/ttyUSB0";
+	int baud = 115200;
+	int timeout_ms = 100;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "+d:b:t:")) != -1)
+	{
+		switch (opt)
+		{
+		case 'd': device = optarg; break;
+		case 'b': baud = atoi(optarg); break;
+		case 't': timeout_ms = atoi(optarg); break;
+		default: usage();
+		}
+	}
+	if (optind >= argc)
+		usage();
+
+	p3pi p;
+	if (p3pi_open(&p, device, baud) < 0)
+	{
+		fprintf(stderr, "3pi-master: %s: %s\n", device, strerror(errno));
+		return 1;
+	}
+	p3pi_set_timeout(&p, timeout_ms);
+
+	if (strcmp(argv[optind], "bench") == 0)
+	{
+		int i = need(argc, optind, 1);
+		long count = atol(argv[i]);
+		long batch = i + 1 < argc ? atol(argv[i + 1]) : 1;
+		if (count < 1 || batch < 1)
+			usage();
+		if (bench(&p, count, batch) < 0)
+		{
+			fprintf(stderr, "3pi-master: %s\n", strerror(errno));
+			return 1;
+		}
+		p3pi_close(&p);
+		return 0;
+	}
+
+	result *results = calloc(argc, sizeof(result));
+	int count = 0;
+	int status = 0;
+	int i;
+
+	p3pi_begin_batch(&p);
+	for (i = optind; i < argc && status == 0; i++)
+	{
+		const char *c = argv[i];
+		result *r = &results[count++];
+		r->name = c;
+
+		if (!strcmp(c, "signature"))
+			r->kind = PRINT_SIGNATURE, status = p3pi_get_signature(&p, r->signature);
+		else if (!strcmp(c, "raw"))
+			r->kind = PRINT_FIVE, status = p3pi_read_raw_sensors(&p, r->values);
+		else if (!strcmp(c, "calibrated"))
+			r->kind = PRINT_FIVE, status = p3pi_read_calibrated_sensors(&p, r->values);
+		else if (!strcmp(c, "line"))
+			r->kind = PRINT_ONE, status = p3pi_read_line_position(&p, r->values);
+		else if (!strcmp(c, "trimpot"))
+			r->kind = PRINT_ONE, status = p3pi_read_trimpot(&p, r->values);
+		else if (!strcmp(c, "battery"))
+			r->kind = PRINT_ONE, status = p3pi_read_battery_millivolts(&p, r->values);
+		else if (!strcmp(c, "calibrate"))
+			r->kind = PRINT_FIVE, status = p3pi_calibrate(&p, r->values);
+		else if (!strcmp(c, "reset-calibration"))
+			status = p3pi_reset_calibration(&p);
+		else if (!strcmp(c, "auto-calibrate"))
+			status = p3pi_auto_calibrate(&p);
+		else if (!strcmp(c, "motors"))
+		{
+			i = need(argc, i, 2);
+			status = p3pi_set_motors(&p, atoi(argv[i - 1]), atoi(argv[i]));
+		}
+		else if (!strcmp(c, "pid"))
+		{
+			i = need(argc, i, 5);
+			status = p3pi_start_pid(&p, atoi(argv[i - 4]), atoi(argv[i - 3]),
+				atoi(argv[i - 2]), atoi(argv[i - 1]), atoi(argv[i]));
+		}
+		else if (!strcmp(c, "stop-pid"))
+			status = p3pi_stop_pid(&p);
+		else if (!strcmp(c, "clear"))
+			status = p3pi_clear(&p);
+		else if (!strcmp(c, "print"))
+		{
+			i = need(argc, i, 1);
+			status = p3pi_print(&p, argv[i]);
+		}
+		else if (!strcmp(c, "goto"))
+		{
+			i = need(argc, i, 2);
+			status = p3pi_lcd_goto_xy(&p, atoi(argv[i - 1]), atoi(argv[i]));
+		}
+		else if (!strcmp(c, "play"))
+		{
+			i = need(argc, i, 1);
+			status = p3pi_play(&p, argv[i]);
+		}
+		else
+		{
+			fprintf(stderr, "3pi-master: unknown command \"%s\"\n", c);
+			usage();
+		}
+	}
+	if (status == 0)
+		status = p3pi_end_batch(&p);
+
+	if (status < 0)
+	{
+		fprintf(stderr, "3pi-master: %s\n", strerror(errno));
+		return 1;
+	}
+
+	for (i = 0; i < count; i++)
+	{
+		result *r = &results[i];
+		switch (r->kind)
+		{
+		case PRINT_SIGNATURE:
+			printf("%s: %s\n", r->name, r->signature);
+			break;
+		case PRINT_ONE:
+			printf("%s: %u\n", r->name, r->values[0]);
+			break;
+		case PRINT_FIVE:
+			printf("%s: %u %u %u %u %u\n", r->name, r->values[0], r->values[1],
+				r->values[2], r->values[3], r->values[4]);
+			break;
+		}
+	}
+
+	free(results);
+	p3pi_close(&p);
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
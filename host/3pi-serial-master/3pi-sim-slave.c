@@ -0,0 +1,259 @@
+/*
+ * 3pi-sim-slave - Simulates a 3pi Robot running 3pi-serial-slave on a
+ * pseudo-terminal, so that the host library and 3pi-master can be tried
+ * without a robot.  It prints the name of the terminal to connect to:
+ *
+ *   ./3pi-sim-slave &
+ *   /dev/pts/5
+ *   ./3pi-master -d /dev/pts/5 signature battery
+ *
+ * With -b, responses are delayed by the time they would take on a real
+ * serial line at that baud rate, and with -v, every command is logged.
+ */
+
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+#include "pololu3pi.h"
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+static int master_fd;
+static long baud;
+static int verbose;
+
+// Simulated robot state.
+static unsigned int sensors[5];
+static unsigned int line_position = 2000;
+static int pid_enabled;
+static int m1_speed, m2_speed;
+static unsigned int step;
+
+static void respond(const void *data, size_t size)
+{
+	if (baud)
+		usleep(size * 10 * 1000000L / baud);
+	if (write(master_fd, data, size) < 0)
+		perror("3pi-sim-slave: write");
+}
+
+static void respond_words(const unsigned int *values, int count)
+{
+	unsigned char out[10];
+	int i;
+	for (i = 0; i < count; i++)
+	{
+		out[2*i] = values[i];
+		out[2*i + 1] = values[i] >> 8;
+	}
+	respond(out, count * 2);
+}
+
+// Moves the simulated line a little for every reading.
+static void update_sensors(void)
+{
+	int i;
+	step++;
+	line_position = 2000 + (int)((step * 37) % 1600) - 800;
+	for (i = 0; i < 5; i++)
+	{
+		int distance = abs((int)line_position - i * 1000);
+		sensors[i] = distance > 1000 ? 0 : 1000 - distance;
+	}
+}
+
+// Returns the length of the command at the start of the buffer, or 0 if
+// more bytes are needed to know it.
+static size_t command_length(const unsigned char *buffer, size_t size)
+{
+	switch (buffer[0])
+	{
+	case P3PI_PLAY:
+	case P3PI_PRINT:
+		return size < 2 ? 0 : 2 + buffer[1];
+	case P3PI_LCD_GOTO_XY:
+		return 3;
+	case P3PI_START_PID:
+		return 6;
+	case P3PI_M1_FORWARD:
+	case P3PI_M1_BACKWARD:
+	case P3PI_M2_FORWARD:
+	case P3PI_M2_BACKWARD:
+		return 2;
+	default:
+		return 1;
+	}
+}
+
+static void execute(const unsigned char *c, size_t length)
+{
+	unsigned int value;
+
+	if (verbose)
+	{
+		size_t i;
+		fprintf(stderr, "3pi-sim-slave:");
+		for (i = 0; i < length; i++)
+			fprintf(stderr, " %02X", c[i]);
+		fprintf(stderr, "\n");
+	}
+
+	switch (c[0])
+	{
+	case 0x00:
+		break;
+	case P3PI_SIGNATURE:
+		respond("3pi1.1", 6);
+		m1_speed = m2_speed = 0;
+		pid_enabled = 0;
+		break;
+	case P3PI_RAW_SENSORS:
+		update_sensors();
+		{
+			unsigned int raw[5];
+			int i;
+			for (i = 0; i < 5; i++)
+				raw[i] = 200 + sensors[i] * 18 / 10;
+			respond_words(raw, 5);
+		}
+		break;
+	case P3PI_CALIBRATED_SENSORS:
+	case P3PI_CALIBRATE:
+		if (!pid_enabled)
+			update_sensors();
+		respond_words(sensors, 5);
+		break;
+	case P3PI_TRIMPOT:
+		value = 512;
+		respond_words(&value, 1);
+		break;
+	case P3PI_BATTERY_MILLIVOLTS:
+		value = 4850;
+		respond_words(&value, 1);
+		break;
+	case P3PI_LINE_POSITION:
+		if (!pid_enabled)
+			update_sensors();
+		respond_words(&line_position, 1);
+		break;
+	case P3PI_AUTO_CALIBRATE:
+		usleep(1000000);
+		respond("c", 1);
+		break;
+	case P3PI_START_PID:
+		pid_enabled = 1;
+		break;
+	case P3PI_STOP_PID:
+		m1_speed = m2_speed = 0;
+		pid_enabled = 0;
+		break;
+	case P3PI_M1_FORWARD:  m1_speed = c[1] == 127 ? 255 : c[1] * 2; break;
+	case P3PI_M1_BACKWARD: m1_speed = c[1] == 127 ? -255 : -c[1] * 2; break;
+	case P3PI_M2_FORWARD:  m2_speed = c[1] == 127 ? 255 : c[1] * 2; break;
+	case P3PI_M2_BACKWARD: m2_speed = c[1] == 127 ? -255 : -c[1] * 2; break;
+	case P3PI_RESET_CALIBRATION:
+	case P3PI_PLAY:
+	case P3PI_CLEAR:
+	case P3PI_PRINT:
+	case P3PI_LCD_GOTO_XY:
+		break;
+	default:
+		fprintf(stderr, "3pi-sim-slave: bad command %02X\n", c[0]);
+		break;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	int opt;
+	while ((opt = getopt(argc, argv, "b:v")) != -1)
+	{
+		switch (opt)
+		{
+		case 'b': baud = atol(optarg); break;
+		case 'v': verbose = 1; break;
+		default:
+			fprintf(stderr, "usage: 3pi-sim-slave [-b baud] [-v]\n");
+			return 2;
+		}
+	}
+
+	master_fd = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master_fd < 0 || grantpt(master_fd) < 0 || unlockpt(master_fd) < 0)
+	{
+		perror("3pi-sim-slave: posix_openpt");
+		return 1;
+	}
+
+	// Keep the terminal side open and raw, so nothing is echoed and the
+	// simulator keeps running when a master disconnects.
+	const char *name = ptsname(master_fd);
+	int slave_fd = open(name, O_RDWR | O_NOCTTY);
+	struct termios t;
+	if (slave_fd < 0 || tcgetattr(slave_fd, &t) < 0)
+	{
+		perror("3pi-sim-slave: open");
+		return 1;
+	}
+	cfmakeraw(&t);
+	tcsetattr(slave_fd, TCSANOW, &t);
+
+	printf("%s\n", name);
+	fflush(stdout);
+
+	// Like the real slave, take bytes from the stream one command at a
+	// time; a data byte where a command is expected is skipped, and a
+	// command byte inside a command's data starts over at that byte.
+	unsigned char buffer[512];
+	size_t size = 0;
+	while (1)
+	{
+		ssize_t n = read(master_fd, buffer + size, sizeof(buffer) - size);
+		if (n <= 0)
+		{
+			usleep(1000);
+			continue;
+		}
+		size += n;
+
+		while (size)
+		{
+			if (buffer[0] < 0x80 && buffer[0] != 0)
+			{
+				fprintf(stderr, "3pi-sim-slave: bad command %02X\n", buffer[0]);
+				memmove(buffer, buffer + 1, --size);
+				continue;
+			}
+
+			size_t length = command_length(buffer, size);
+			size_t i;
+			for (i = 1; i < length && i < size; i++)
+				if (buffer[i] & 0x80)
+					break;
+			if (i < length && i < size)
+			{
+				fprintf(stderr, "3pi-sim-slave: bad data %02X\n", buffer[i]);
+				memmove(buffer, buffer + i, size - i);
+				size -= i;
+				continue;
+			}
+			if (length == 0 || length > size)
+				break;	// wait for the rest
+
+			execute(buffer, length);
+			memmove(buffer, buffer + length, size - length);
+			size -= length;
+		}
+	}
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,457 @@
+/*
+ * pololu3pi.c - Linux host library for talking to a 3pi Robot running
+ * the 3pi-serial-slave program over a serial port.
+ *
+ * http://www.pololu.com/docs/0J21
+ * http://www.pololu.com/docs/0J20
+ */
+
+#define _DEFAULT_SOURCE
+#include "pololu3pi.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+static unsigned long long now_us(void)
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (unsigned long long)t.tv_sec * 1000000 + t.tv_nsec / 1000;
+}
+
+static speed_t baud_constant(int baud)
+{
+	switch(baud)
+	{
+	case 9600: return B9600;
+	case 19200: return B19200;
+	case 38400: return B38400;
+	case 57600: return B57600;
+	case 115200: return B115200;
+	case 230400: return B230400;
+	default: return 0;
+	}
+}
+
+static int set_raw(int fd, int baud)
+{
+	struct termios t;
+	if (tcgetattr(fd, &t) < 0)
+		return errno == ENOTTY ? 0 : -1;	// not a terminal, e.g. a socket
+
+	cfmakeraw(&t);
+	t.c_cflag |= CLOCAL | CREAD;
+	t.c_cc[VMIN] = 0;
+	t.c_cc[VTIME] = 0;
+	if (baud)
+	{
+		speed_t speed = baud_constant(baud);
+		if (!speed)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		cfsetispeed(&t, speed);
+		cfsetospeed(&t, speed);
+	}
+	if (tcsetattr(fd, TCSANOW, &t) < 0)
+		return -1;
+	tcflush(fd, TCIOFLUSH);
+	return 0;
+}
+
+static void init(p3pi *p, int fd)
+{
+	memset(p, 0, sizeof(*p));
+	p->fd = fd;
+	p->timeout_ms = 100;
+	p3pi_reset_stats(p);
+}
+
+int p3pi_open(p3pi *p, const char *device, int baud)
+{
+	int fd = open(device, O_RDWR | O_NOCTTY);
+	if (fd < 0)
+		return -1;
+	init(p, fd);
+	if (set_raw(fd, baud) < 0)
+	{
+		int e = errno;
+		close(fd);
+		errno = e;
+		return -1;
+	}
+	return 0;
+}
+
+int p3pi_attach(p3pi *p, int fd)
+{
+	init(p, fd);
+	return set_raw(fd, 0);
+}
+
+void p3pi_close(p3pi *p)
+{
+	if (p->fd >= 0)
+		close(p->fd);
+	p->fd = -1;
+}
+
+void p3pi_set_timeout(p3pi *p, int timeout_ms)
+{
+	p->timeout_ms = timeout_ms;
+}
+
+/** BATCHES *******************************************************************/
+
+static int write_all(int fd, const unsigned char *data, size_t size)
+{
+	while (size)
+	{
+		ssize_t n = write(fd, data, size);
+		if (n < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		data += n;
+		size -= n;
+	}
+	return 0;
+}
+
+// Reads exactly size bytes, giving up if none arrive for timeout_ms.
+static int read_all(int fd, unsigned char *data, size_t size, int timeout_ms)
+{
+	while (size)
+	{
+		struct pollfd pfd = { fd, POLLIN, 0 };
+		int r = poll(&pfd, 1, timeout_ms);
+		if (r < 0)
+		{
+			if (errno == EINTR)
+				continue;
+			return -1;
+		}
+		if (r == 0)
+		{
+			errno = ETIMEDOUT;
+			return -1;
+		}
+
+		ssize_t n = read(fd, data, size);
+		if (n < 0)
+		{
+			if (errno == EINTR || errno == EAGAIN)
+				continue;
+			return -1;
+		}
+		if (n == 0)
+		{
+			errno = EIO;	// the other end went away
+			return -1;
+		}
+		data += n;
+		size -= n;
+	}
+	return 0;
+}
+
+int p3pi_flush(p3pi *p)
+{
+	unsigned char response[P3PI_MAX_BATCH_COMMANDS * 10];
+	unsigned int i, offset;
+
+	if (p->out_length == 0)
+		return 0;
+
+	unsigned long long start = now_us();
+	int result = write_all(p->fd, p->out, p->out_length);
+	if (result == 0)
+		result = read_all(p->fd, response, p->response_length, p->timeout_ms);
+	unsigned long elapsed = now_us() - start;
+
+	if (result == 0)
+	{
+		// Hand out the responses, in the order the commands were queued.
+		offset = 0;
+		for (i = 0; i < p->request_count; i++)
+		{
+			p3pi_request *r = &p->requests[i];
+			if (r->words)
+			{
+				unsigned int *values = r->destination;
+				unsigned int j;
+				for (j = 0; j < r->length / 2u; j++)
+					values[j] = response[offset + 2*j] | (response[offset + 2*j + 1] << 8);
+			}
+			else if (r->destination)
+			{
+				memcpy(r->destination, response + offset, r->length);
+			}
+			offset += r->length;
+		}
+
+		p->stats.batches++;
+		p->stats.commands += p->request_count;
+		p->stats.bytes_sent += p->out_length;
+		p->stats.bytes_received += p->response_length;
+		p->stats.total_us += elapsed;
+		if (elapsed < p->stats.min_us)
+			p->stats.min_us = elapsed;
+		if (elapsed > p->stats.max_us)
+			p->stats.max_us = elapsed;
+	}
+	else
+	{
+		// Throw away anything that arrives late, so that it does not
+		// get mistaken for the response to the next command.
+		tcflush(p->fd, TCIFLUSH);
+	}
+
+	p->out_length = 0;
+	p->request_count = 0;
+	p->response_length = 0;
+	return result;
+}
+
+void p3pi_begin_batch(p3pi *p)
+{
+	p->batching = 1;
+}
+
+int p3pi_end_batch(p3pi *p)
+{
+	p->batching = 0;
+	return p3pi_flush(p);
+}
+
+static int queue(p3pi *p, const unsigned char *command, size_t size,
+	void *destination, size_t response_length, int words)
+{
+	if (size == 0 || size > P3PI_MAX_COMMAND_BYTES)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	// Start a new piece of the batch if this command does not fit.
+	if (p->out_length && (p->out_length + size > P3PI_MAX_BATCH_BYTES ||
+		p->request_count == P3PI_MAX_BATCH_COMMANDS))
+	{
+		if (p3pi_flush(p) < 0)
+			return -1;
+	}
+
+	memcpy(p->out + p->out_length, command, size);
+	p->out_length += size;
+
+	p3pi_request *r = &p->requests[p->request_count++];
+	r->length = response_length;
+	r->words = words;
+	r->destination = destination;
+	p->response_length += response_length;
+
+	if (!p->batching)
+		return p3pi_flush(p);
+	return 0;
+}
+
+int p3pi_command(p3pi *p, const unsigned char *command, size_t size,
+	void *response, size_t response_length)
+{
+	if (response_length > 10)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return queue(p, command, size, response, response_length, 0);
+}
+
+const p3pi_stats *p3pi_get_stats(p3pi *p)
+{
+	return &p->stats;
+}
+
+void p3pi_reset_stats(p3pi *p)
+{
+	memset(&p->stats, 0, sizeof(p->stats));
+	p->stats.min_us = (unsigned long)-1;
+}
+
+/** COMMANDS ******************************************************************/
+
+static int simple(p3pi *p, unsigned char command)
+{
+	return queue(p, &command, 1, 0, 0, 0);
+}
+
+static int read_words(p3pi *p, unsigned char command, unsigned int *values, int count)
+{
+	return queue(p, &command, 1, values, count * 2, 1);
+}
+
+int p3pi_get_signature(p3pi *p, char signature[7])
+{
+	unsigned char command = P3PI_SIGNATURE;
+	signature[6] = 0;
+	return queue(p, &command, 1, signature, 6, 0);
+}
+
+int p3pi_read_raw_sensors(p3pi *p, unsigned int sensors[5])
+{
+	return read_words(p, P3PI_RAW_SENSORS, sensors, 5);
+}
+
+int p3pi_read_calibrated_sensors(p3pi *p, unsigned int sensors[5])
+{
+	return read_words(p, P3PI_CALIBRATED_SENSORS, sensors, 5);
+}
+
+int p3pi_read_line_position(p3pi *p, unsigned int *position)
+{
+	return read_words(p, P3PI_LINE_POSITION, position, 1);
+}
+
+int p3pi_read_trimpot(p3pi *p, unsigned int *value)
+{
+	return read_words(p, P3PI_TRIMPOT, value, 1);
+}
+
+int p3pi_read_battery_millivolts(p3pi *p, unsigned int *millivolts)
+{
+	return read_words(p, P3PI_BATTERY_MILLIVOLTS, millivolts, 1);
+}
+
+int p3pi_calibrate(p3pi *p, unsigned int sensors[5])
+{
+	return read_words(p, P3PI_CALIBRATE, sensors, 5);
+}
+
+int p3pi_reset_calibration(p3pi *p)
+{
+	return simple(p, P3PI_RESET_CALIBRATION);
+}
+
+int p3pi_auto_calibrate(p3pi *p)
+{
+	// The slave spins the robot for one second, then sends 'c'.
+	unsigned char command = P3PI_AUTO_CALIBRATE;
+	int timeout = p->timeout_ms;
+	int result;
+
+	if (p3pi_flush(p) < 0)
+		return -1;
+	p->timeout_ms = timeout + 1500;
+	result = queue(p, &command, 1, 0, 1, 0);
+	if (result == 0 && p->batching)
+		result = p3pi_flush(p);
+	p->timeout_ms = timeout;
+	return result;
+}
+
+// Converts a speed from -255 to 255 into a command and a data byte.
+static void motor_bytes(unsigned char *out, int speed, unsigned char forward, unsigned char backward)
+{
+	out[0] = speed < 0 ? backward : forward;
+	if (speed < 0)
+		speed = -speed;
+	out[1] = speed >= 255 ? 127 : speed / 2;
+}
+
+int p3pi_set_motors(p3pi *p, int left, int right)
+{
+	unsigned char command[4];
+	motor_bytes(command, left, P3PI_M1_FORWARD, P3PI_M1_BACKWARD);
+	motor_bytes(command + 2, right, P3PI_M2_FORWARD, P3PI_M2_BACKWARD);
+	return queue(p, command, 4, 0, 0, 0);
+}
+
+int p3pi_start_pid(p3pi *p, int max_speed, int p_num, int p_den, int d_num, int d_den)
+{
+	int values[5] = { max_speed, p_num, p_den, d_num, d_den };
+	unsigned char command[6] = { P3PI_START_PID };
+	int i;
+	for (i = 0; i < 5; i++)
+	{
+		if (values[i] < 0 || values[i] > 127)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		command[i + 1] = values[i];
+	}
+	return queue(p, command, 6, 0, 0, 0);
+}
+
+int p3pi_stop_pid(p3pi *p)
+{
+	return simple(p, P3PI_STOP_PID);
+}
+
+int p3pi_clear(p3pi *p)
+{
+	return simple(p, P3PI_CLEAR);
+}
+
+// Queues a command followed by a length byte and a 7-bit string.
+static int string_command(p3pi *p, unsigned char command, const char *text, size_t max_length)
+{
+	unsigned char out[P3PI_MAX_COMMAND_BYTES];
+	size_t length = strlen(text);
+	size_t i;
+
+	if (length > max_length || length + 2 > sizeof(out))
+	{
+		errno = EINVAL;
+		return -1;
+	}
+
+	out[0] = command;
+	out[1] = length;
+	for (i = 0; i < length; i++)
+	{
+		if (text[i] & 0x80)
+		{
+			errno = EINVAL;
+			return -1;
+		}
+		out[i + 2] = text[i];
+	}
+	return queue(p, out, length + 2, 0, 0, 0);
+}
+
+int p3pi_print(p3pi *p, const char *text)
+{
+	return string_command(p, P3PI_PRINT, text, 99);
+}
+
+int p3pi_lcd_goto_xy(p3pi *p, int x, int y)
+{
+	unsigned char command[3] = { P3PI_LCD_GOTO_XY, x, y };
+	if (x < 0 || x > 127 || y < 0 || y > 127)
+	{
+		errno = EINVAL;
+		return -1;
+	}
+	return queue(p, command, 3, 0, 0, 0);
+}
+
+int p3pi_play(p3pi *p, const char *melody)
+{
+	// The slave's music buffer is 100 bytes including the terminating 0.
+	return string_command(p, P3PI_PLAY, melody, 99);
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
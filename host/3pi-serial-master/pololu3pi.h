@@ -0,0 +1,160 @@
+/*
+ * pololu3pi.h - Linux host library for talking to a 3pi Robot running
+ * the 3pi-serial-slave program over a serial port.
+ *
+ * Commands are queued in a batch and sent in one write, and their
+ * responses are read back in order, so many commands can be in flight at
+ * once.  Outside of a batch every command is sent immediately and waits
+ * for its response.
+ *
+ * http://www.pololu.com/docs/0J21
+ * http://www.pololu.com/docs/0J20
+ */
+
+#ifndef pololu3pi_h
+#define pololu3pi_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Command bytes understood by 3pi-serial-slave.
+#define P3PI_SIGNATURE				0x81
+#define P3PI_RAW_SENSORS			0x86
+#define P3PI_CALIBRATED_SENSORS		0x87
+#define P3PI_TRIMPOT				0xB0
+#define P3PI_BATTERY_MILLIVOLTS		0xB1
+#define P3PI_PLAY					0xB3
+#define P3PI_CALIBRATE				0xB4
+#define P3PI_RESET_CALIBRATION		0xB5
+#define P3PI_LINE_POSITION			0xB6
+#define P3PI_CLEAR					0xB7
+#define P3PI_PRINT					0xB8
+#define P3PI_LCD_GOTO_XY			0xB9
+#define P3PI_AUTO_CALIBRATE			0xBA
+#define P3PI_START_PID				0xBB
+#define P3PI_STOP_PID				0xBC
+#define P3PI_M1_FORWARD				0xC1
+#define P3PI_M1_BACKWARD			0xC2
+#define P3PI_M2_FORWARD				0xC5
+#define P3PI_M2_BACKWARD			0xC6
+
+// The slave's receive ring is 100 bytes, so a batch is sent in pieces of
+// at most this many command bytes, each one after the responses to the
+// previous piece have arrived.  A single command (print or play) can be
+// longer, up to P3PI_MAX_COMMAND_BYTES.
+#define P3PI_MAX_BATCH_BYTES		64
+#define P3PI_MAX_BATCH_COMMANDS		32
+#define P3PI_MAX_COMMAND_BYTES		101
+
+typedef struct p3pi_stats
+{
+	unsigned long batches;			// number of round trips
+	unsigned long commands;
+	unsigned long bytes_sent;
+	unsigned long bytes_received;
+	unsigned long long total_us;	// total round-trip time
+	unsigned long min_us;			// shortest round trip
+	unsigned long max_us;			// longest round trip
+} p3pi_stats;
+
+typedef struct p3pi_request
+{
+	unsigned char length;			// response bytes
+	unsigned char words;			// nonzero: decode as 16-bit values
+	void *destination;
+} p3pi_request;
+
+typedef struct p3pi
+{
+	int fd;
+	int timeout_ms;
+	int batching;
+
+	unsigned char out[P3PI_MAX_BATCH_BYTES + P3PI_MAX_COMMAND_BYTES];
+	unsigned int out_length;
+	p3pi_request requests[P3PI_MAX_BATCH_COMMANDS];
+	unsigned int request_count;
+	unsigned int response_length;
+
+	p3pi_stats stats;
+} p3pi;
+
+// Opens a serial device (e.g. /dev/ttyUSB0) and sets it to raw 8N1 at
+// the given baud rate.  The slave program uses 115200.  Returns 0, or -1
+// with errno set.
+int p3pi_open(p3pi *p, const char *device, int baud);
+
+// Uses a file descriptor that is already open, such as a pseudo-terminal.
+// If it is a terminal, it is set to raw mode.
+int p3pi_attach(p3pi *p, int fd);
+
+void p3pi_close(p3pi *p);
+
+// Sets how long to wait for a response before failing with ETIMEDOUT.
+// The default is 100 ms; auto-calibration takes about one second.
+void p3pi_set_timeout(p3pi *p, int timeout_ms);
+
+// Starts queueing commands instead of sending each one right away.  The
+// values that commands return are not filled in until p3pi_end_batch()
+// or p3pi_flush() returns 0.
+void p3pi_begin_batch(p3pi *p);
+
+// Sends everything that is queued and waits for all the responses.
+int p3pi_flush(p3pi *p);
+
+// Flushes and goes back to sending every command right away.
+int p3pi_end_batch(p3pi *p);
+
+// Queues any command: size bytes from command, followed by a response of
+// response_length bytes stored in response.  All bytes after the first
+// must be below 0x80.
+int p3pi_command(p3pi *p, const unsigned char *command, size_t size,
+	void *response, size_t response_length);
+
+// The commands of 3pi-serial-slave.  Each returns 0 on success, or -1
+// with errno set.  Values are not valid until the command has been
+// flushed.
+int p3pi_get_signature(p3pi *p, char signature[7]);
+int p3pi_read_raw_sensors(p3pi *p, unsigned int sensors[5]);
+int p3pi_read_calibrated_sensors(p3pi *p, unsigned int sensors[5]);
+int p3pi_read_line_position(p3pi *p, unsigned int *position);
+int p3pi_read_trimpot(p3pi *p, unsigned int *value);
+int p3pi_read_battery_millivolts(p3pi *p, unsigned int *millivolts);
+int p3pi_calibrate(p3pi *p, unsigned int sensors[5]);
+int p3pi_reset_calibration(p3pi *p);
+int p3pi_auto_calibrate(p3pi *p);
+
+// Speeds are -255 to 255.  The slave has a resolution of 2.
+int p3pi_set_motors(p3pi *p, int left, int right);
+
+// Starts the slave's PID line follower.  All arguments must be 0-127;
+// max_speed is doubled by the slave (127 means 255).
+int p3pi_start_pid(p3pi *p, int max_speed, int p_num, int p_den, int d_num, int d_den);
+int p3pi_stop_pid(p3pi *p);
+
+int p3pi_clear(p3pi *p);
+int p3pi_print(p3pi *p, const char *text);
+int p3pi_lcd_goto_xy(p3pi *p, int x, int y);
+
+// Plays a melody (see OrangutanBuzzer::play); at most 99 characters.
+int p3pi_play(p3pi *p, const char *melody);
+
+// Returns the statistics collected since the last reset.
+const p3pi_stats *p3pi_get_stats(p3pi *p);
+void p3pi_reset_stats(p3pi *p);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,29 @@
+/*
+ * avr/pgmspace.h - Stand-in for the avr-libc header so that
+ * PololuFixedMath.cpp can be compiled and tested on the PC.  Program
+ * space is ordinary memory here.
+ */
+
+#ifndef host_pgmspace_h
+#define host_pgmspace_h
+
+#include <string.h>
+
+#define PROGMEM
+
+// Reads the low 16 bits of a table entry (the PC is little-endian).
+static inline unsigned short pgm_read_word(const void *address)
+{
+	unsigned short value;
+	memcpy(&value, address, sizeof(value));
+	return value;
+}
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,194 @@
+/*
+ * fixed-math-test.cpp - Compares PololuFixedMath against the C math
+ * library on the PC and checks the error bounds documented in
+ * PololuFixedMath.h.  Exits with status 1 if any bound is exceeded.
+ *
+ * The library is compiled for the PC, where int is 32 bits, so the 16-bit
+ * AVR types are emulated by converting the results as the AVR would.
+ */
+
+#include "../../src/PololuFixedMath/PololuFixedMath.h"
+
+#include <math.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#define SIN_LIMIT		3	// Q15 units
+#define ATAN2_LIMIT		13	// binary angle units
+
+static int failures = 0;
+
+static void report(const char *name, long worst, long limit)
+{
+	int ok = worst <= limit;
+	printf("%-6s max error %ld (limit %ld) %s\n", name, worst, limit, ok ? "ok" : "FAILED");
+	if (!ok)
+		failures++;
+}
+
+// the AVR's int is 16 bits
+static long as_int16(int value)
+{
+	return (short)value;
+}
+
+static void test_sin_cos()
+{
+	long worst_sin = 0, worst_cos = 0;
+
+	for (long angle = 0; angle < 65536; angle++)
+	{
+		double radians = angle * 2 * M_PI / 65536;
+		long expected_sin = lround(sin(radians) * 32767);
+		long expected_cos = lround(cos(radians) * 32767);
+		long s = as_int16(PololuFixedMath::sin(angle));
+		long c = as_int16(PololuFixedMath::cos((unsigned short)angle));
+		worst_sin = fmax(worst_sin, labs(s - expected_sin));
+		worst_cos = fmax(worst_cos, labs(c - expected_cos));
+	}
+
+	report("sin", worst_sin, SIN_LIMIT);
+	report("cos", worst_cos, SIN_LIMIT);
+}
+
+static long angle_error(unsigned int angle, double expected)
+{
+	long difference = (long)(angle & 0xFFFF) - lround(expected);
+	difference = ((difference % 65536) + 65536 + 32768) % 65536 - 32768;
+	return labs(difference);
+}
+
+static void test_atan2()
+{
+	long worst = 0;
+
+	// every direction at several lengths, including the extremes
+	static const double lengths[] = { 1.5, 10, 100, 4096, 20000, 32767 };
+	for (unsigned int l = 0; l < sizeof(lengths) / sizeof(lengths[0]); l++)
+	{
+		for (long a = 0; a < 65536; a++)
+		{
+			double radians = a * 2 * M_PI / 65536;
+			int x = lround(cos(radians) * lengths[l]);
+			int y = lround(sin(radians) * lengths[l]);
+			if (x == 0 && y == 0)
+				continue;
+			double expected = atan2(y, x) * 65536 / (2 * M_PI);
+			worst = fmax(worst, angle_error(PololuFixedMath::atan2(y, x), expected));
+		}
+	}
+
+	// every vector with small components, where rounding matters most
+	for (int y = -512; y <= 512; y++)
+	{
+		for (int x = -512; x <= 512; x++)
+		{
+			if (x == 0 && y == 0)
+				continue;
+			double expected = atan2(y, x) * 65536 / (2 * M_PI);
+			worst = fmax(worst, angle_error(PololuFixedMath::atan2(y, x), expected));
+		}
+	}
+
+	// a grid over the whole 16-bit range
+	for (long y = -32768; y < 32768; y += 97)
+	{
+		for (long x = -32768; x < 32768; x += 89)
+		{
+			double expected = atan2(y, x) * 65536 / (2 * M_PI);
+			worst = fmax(worst, angle_error(PololuFixedMath::atan2(y, x), expected));
+		}
+	}
+
+	// the corners of the 16-bit range, and the worst vectors found by
+	// longer searches
+	static const int corners[][2] = {
+		{ -32768, -32768 }, { -32768, 32767 }, { 32767, -32768 }, { 32767, 32767 },
+		{ -32768, 0 }, { 0, -32768 }, { 1, -32768 }, { -32768, 1 },
+		{ -17319, 1347 }, { -1539, -19790 }, { 1297, 16696 } };
+	for (unsigned int i = 0; i < sizeof(corners) / sizeof(corners[0]); i++)
+	{
+		int y = corners[i][0], x = corners[i][1];
+		double expected = atan2(y, x) * 65536 / (2 * M_PI);
+		worst = fmax(worst, angle_error(PololuFixedMath::atan2(y, x), expected));
+	}
+
+	report("atan2", worst, ATAN2_LIMIT);
+
+	if (PololuFixedMath::atan2(0, 0) != 0)
+	{
+		printf("atan2(0, 0) is not 0 FAILED\n");
+		failures++;
+	}
+}
+
+static void test_sqrt()
+{
+	long worst = 0;
+	unsigned long x = 0;
+
+	// every value up to 2^20, then a spread up to 2^32 - 1
+	for (x = 0; x < (1UL << 20); x++)
+		worst = fmax(worst, labs((long)(PololuFixedMath::sqrt(x) & 0xFFFF) - (long)floor(sqrt((double)x))));
+	for (unsigned long long y = 1UL << 20; y <= 0xFFFFFFFFULL; y += 65521)
+	{
+		x = y;
+		worst = fmax(worst, labs((long)(PololuFixedMath::sqrt(x) & 0xFFFF) - (long)floor(sqrt((double)x))));
+	}
+	x = 0xFFFFFFFFUL;
+	worst = fmax(worst, labs((long)(PololuFixedMath::sqrt(x) & 0xFFFF) - (long)floor(sqrt((double)x))));
+
+	report("sqrt", worst, 0);
+}
+
+static void test_hypot()
+{
+	long worst = 0;
+
+	for (long y = -32768; y < 32768; y += 257)
+	{
+		for (long x = -32768; x < 32768; x += 251)
+		{
+			long expected = floor(sqrt((double)x * x + (double)y * y));
+			worst = fmax(worst, labs((long)(PololuFixedMath::hypot(x, y) & 0xFFFF) - expected));
+		}
+	}
+	long expected = floor(sqrt(2.0 * 32768 * 32768));
+	worst = fmax(worst, labs((long)(PololuFixedMath::hypot(-32768, -32768) & 0xFFFF) - expected));
+
+	report("hypot", worst, 0);
+}
+
+static void test_q15_from_float()
+{
+	static const struct { double value; int expected; } cases[] = {
+		{ 1.0, Q15_ONE }, { 0.99999, Q15_ONE }, { 2.0, Q15_ONE }, { 0.5, 16384 },
+		{ 0, 0 }, { -0.5, -16384 }, { -1.0, -32768 }, { -2.0, -32768 } };
+
+	for (unsigned int i = 0; i < sizeof(cases) / sizeof(cases[0]); i++)
+	{
+		int q15 = Q15_FROM_FLOAT(cases[i].value);
+		if (q15 != cases[i].expected)
+		{
+			printf("Q15_FROM_FLOAT(%g) is %d, not %d FAILED\n", cases[i].value, q15, cases[i].expected);
+			failures++;
+		}
+	}
+}
+
+int main()
+{
+	test_sin_cos();
+	test_atan2();
+	test_sqrt();
+	test_hypot();
+	test_q15_from_float();
+	return failures ? 1 : 0;
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
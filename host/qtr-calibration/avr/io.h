@@ -0,0 +1,26 @@
+/*
+ * avr/io.h - Stand-in for the avr-libc header so that PololuQTRSensors.cpp
+ * can be compiled on the PC.  The registers are plain variables; the test
+ * only calls the calibration code, which does not use them.
+ */
+
+#ifndef host_io_h
+#define host_io_h
+
+extern volatile unsigned char PINA, PINB, PINC, PIND;
+extern volatile unsigned char PORTA, PORTB, PORTC, PORTD;
+extern volatile unsigned char DDRA, DDRB, DDRC, DDRD;
+extern volatile unsigned char TCCR2A, TCCR2B, TCNT2;
+extern volatile unsigned char ADMUX, ADCSRA;
+extern volatile unsigned int ADC;
+
+#define ADSC	6
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,148 @@
+/*
+ * qtr-calibration-test.cpp - Checks the online recalibration of
+ * PololuQTRSensors on the PC: calibrated ranges must shrink towards the
+ * readings at the documented rate once the old extremes are no longer
+ * seen, for analog and RC sensors, and must still widen quickly for
+ * readings just outside the range.
+ *
+ * Exits with status 1 if a check fails.
+ */
+
+#include <math.h>
+#include <stdio.h>
+
+/** STAND-INS FOR THE REST OF THE LIBRARY *************************************/
+
+// Keep the real headers out; the calibration code does not need them.
+#define OrangutanDigital_h
+#define OrangutanTime_h
+#define OrangutanProfiler_h
+
+#define PROFILE_SCOPE(name)
+
+struct IOStruct
+{
+	volatile unsigned char *pinRegister;
+	volatile unsigned char *portRegister;
+	volatile unsigned char *ddrRegister;
+	unsigned char bitmask;
+};
+
+class OrangutanDigital
+{
+  public:
+	static void getIORegisters(struct IOStruct *io, unsigned char)
+	{
+		static volatile unsigned char dummy;
+		io->pinRegister = io->portRegister = io->ddrRegister = &dummy;
+		io->bitmask = 0;
+	}
+};
+
+static inline void delayMicroseconds(unsigned int) { }
+
+#include "avr/io.h"
+
+volatile unsigned char PINA, PINB, PINC, PIND;
+volatile unsigned char PORTA, PORTB, PORTC, PORTD;
+volatile unsigned char DDRA, DDRB, DDRC, DDRD;
+volatile unsigned char TCCR2A, TCCR2B, TCNT2;
+volatile unsigned char ADMUX, ADCSRA;
+volatile unsigned int ADC;
+
+// The test drives updateCalibration() directly.
+#define private public
+#define protected public
+#include "../../src/PololuQTRSensors/PololuQTRSensors.cpp"
+#undef private
+#undef protected
+
+/** CHECKS ********************************************************************/
+
+static int failures;
+
+static void check(int ok, const char *what)
+{
+	if (!ok)
+	{
+		printf("FAILED: %s\n", what);
+		failures++;
+	}
+}
+
+// Feeds a steady reading in the middle of a stale range and compares how
+// far each end has moved with the exponential decay the header promises:
+// after r readings, each end keeps (1 - 2^-(shift+6))^r of its gap.
+static void checkDecay(PololuQTRSensors *qtr, const char *name, unsigned int maxValue,
+					   unsigned int calmin0, unsigned int calmax0, unsigned int value,
+					   unsigned char shift)
+{
+	unsigned int calmin[1] = { calmin0 }, calmax[1] = { calmax0 }, reading[1] = { value };
+	unsigned long readings = 1UL << (shift + 5);	// about 40% of each gap goes
+
+	qtr->_numSensors = 1;
+	qtr->_maxValue = maxValue;
+	qtr->_onlineCalibrationShift = shift;
+
+	for (unsigned long i = 0; i < readings; i++)
+		qtr->updateCalibration(reading, calmin, calmax);
+
+	double keep = pow(1 - ldexp(1, -(shift + 6)), readings);
+	double expectMin = value - (value - calmin0) * keep;
+	double expectMax = value + (calmax0 - value) * keep;
+
+	printf("%s shift %u: %u-%u -> %u-%u after %lu readings (expected %.0f-%.0f)\n",
+		   name, shift, calmin0, calmax0, calmin[0], calmax[0], readings, expectMin, expectMax);
+
+	check(fabs(calmin[0] - expectMin) <= 2 + 0.03 * (value - calmin0), "the minimum decays at the documented rate");
+	check(fabs(calmax[0] - expectMax) <= 2 + 0.03 * (calmax0 - value), "the maximum decays at the documented rate");
+
+	// Given long enough, the range shrinks to 1/8 of maxValue and stops.
+	unsigned int minRange = maxValue >> 3;
+	for (unsigned long i = 0; i < 100 * readings; i++)
+		qtr->updateCalibration(reading, calmin, calmax);
+
+	printf("%s shift %u: %u-%u in the end (range %u, floor %u)\n",
+		   name, shift, calmin[0], calmax[0], calmax[0] - calmin[0], minRange);
+
+	check(calmax[0] - calmin[0] <= minRange && calmax[0] - calmin[0] + 2 >= minRange, "the range shrinks to its floor");
+	check(calmin[0] <= value && calmax[0] >= value, "the range still contains the reading");
+}
+
+int main()
+{
+	PololuQTRSensorsAnalog analog;
+	PololuQTRSensorsRC rc;
+	analog._calibrationDither = 0;
+	rc._calibrationDither = 0;
+
+	for (unsigned char shift = 4; shift <= 6; shift++)
+	{
+		// analog: 0 - 1023, so every gap is under 1024 counts
+		checkDecay(&analog, "analog", 1023, 100, 1000, 500, shift);
+		checkDecay(&analog, "analog", 1023, 300, 700, 450, shift);
+
+		// RC with a timeout of 4000
+		checkDecay(&rc, "RC", 4000, 300, 1500, 900, shift);
+		checkDecay(&rc, "RC", 4000, 1000, 3500, 1500, shift);
+	}
+
+	// A reading just outside the range still pulls that end out.
+	unsigned int calmin[1] = { 100 }, calmax[1] = { 900 }, reading[1] = { 1000 };
+	analog._maxValue = 1023;
+	analog._onlineCalibrationShift = 4;
+	analog.updateCalibration(reading, calmin, calmax);
+	check(calmax[0] == 900 + (100 >> 4) + 1 && calmin[0] == 100, "an outside reading widens the range");
+
+	if (failures)
+		return 1;
+	printf("all checks passed\n");
+	return 0;
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,78 @@
+/*
+ * qtr-unpack.c - Reads a stream of packed QTR sensor frames (as logged
+ * from readCalibratedFrame()) and prints one line of 0 - 1000 values
+ * per frame.
+ *
+ * Usage: qtr-unpack -n <sensors> [-f 8|4] [file]
+ */
+
+#define _DEFAULT_SOURCE
+#include "qtrframes.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+static void usage(void)
+{
+	fprintf(stderr, "usage: qtr-unpack -n <sensors> [-f 8|4] [file]\n");
+	exit(2);
+}
+
+int main(int argc, char **argv)
+{
+	int num_sensors = 0, format = QTR_FRAME_8BIT;
+	unsigned char frame[64];
+	unsigned int values[128];
+	size_t size;
+	FILE *in = stdin;
+	int c, i;
+
+	while((c = getopt(argc, argv, "n:f:")) != -1)
+	{
+		switch(c)
+		{
+		case 'n':
+			num_sensors = atoi(optarg);
+			break;
+		case 'f':
+			format = atoi(optarg);
+			break;
+		default:
+			usage();
+		}
+	}
+
+	size = qtr_frame_size(format, num_sensors);
+	if(num_sensors <= 0 || num_sensors > 128 || size == 0 || size > sizeof(frame))
+		usage();
+
+	if(optind < argc)
+	{
+		in = fopen(argv[optind], "rb");
+		if(!in)
+		{
+			perror(argv[optind]);
+			return 1;
+		}
+	}
+
+	while(fread(frame, 1, size, in) == size)
+	{
+		qtr_unpack_frame(frame, format, num_sensors, values);
+		for(i = 0; i < num_sensors; i++)
+			printf(i ? " %u" : "%u", values[i]);
+		printf("\n");
+	}
+
+	if(in != stdin)
+		fclose(in);
+	return 0;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
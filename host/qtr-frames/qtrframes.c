@@ -0,0 +1,50 @@
+/*
+ * qtrframes.c - Host-side helpers for unpacking the compact calibrated
+ * sensor frames written by PololuQTRSensors::readCalibratedFrame().
+ *
+ * http://www.pololu.com/docs/0J18
+ */
+
+#include "qtrframes.h"
+
+size_t qtr_frame_size(int format, int num_sensors)
+{
+	if(format == QTR_FRAME_8BIT)
+		return num_sensors;
+	if(format == QTR_FRAME_4BIT)
+		return (num_sensors + 1) / 2;
+	return 0;
+}
+
+unsigned int qtr_frame_get(const unsigned char *frame, int format, int sensor)
+{
+	if(format == QTR_FRAME_4BIT)
+		return (sensor & 1) ? frame[sensor / 2] >> 4 : frame[sensor / 2] & 0x0F;
+	return frame[sensor];
+}
+
+size_t qtr_unpack_frame(const unsigned char *frame, int format,
+						int num_sensors, unsigned int *values)
+{
+	unsigned int scale;
+	int i;
+
+	if(format == QTR_FRAME_8BIT)
+		scale = 255;
+	else if(format == QTR_FRAME_4BIT)
+		scale = 15;
+	else
+		return 0;
+
+	for(i = 0; i < num_sensors; i++)
+		values[i] = (qtr_frame_get(frame, format, i) * 1000 + scale / 2) / scale;
+
+	return qtr_frame_size(format, num_sensors);
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
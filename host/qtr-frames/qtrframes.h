@@ -0,0 +1,54 @@
+/*
+ * qtrframes.h - Host-side helpers for unpacking the compact calibrated
+ * sensor frames written by PololuQTRSensors::readCalibratedFrame()
+ * (qtr_read_calibrated_frame() in C).
+ *
+ * A QTR_FRAME_8BIT frame has one byte (0 - 255) per sensor.  A
+ * QTR_FRAME_4BIT frame has four bits (0 - 15) per sensor, two sensors per
+ * byte with the lower-numbered sensor in the low nibble; with an odd
+ * number of sensors the high nibble of the last byte is 0.
+ *
+ * http://www.pololu.com/docs/0J18
+ */
+
+#ifndef qtrframes_h
+#define qtrframes_h
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Frame formats, matching PololuQTRSensors.h.
+#ifndef QTR_FRAME_8BIT
+#define QTR_FRAME_8BIT 8
+#define QTR_FRAME_4BIT 4
+#endif
+
+// Returns the size in bytes of one frame for the given number of
+// sensors, or 0 if the format is not recognized.
+size_t qtr_frame_size(int format, int num_sensors);
+
+// Returns the packed value (0 - 255 or 0 - 15) of one sensor in a frame.
+unsigned int qtr_frame_get(const unsigned char *frame, int format, int sensor);
+
+// Unpacks a frame into values on the same 0 - 1000 scale that
+// readCalibrated() returns; 0 and the largest packed value map exactly to
+// 0 and 1000.  Returns the number of frame bytes used, or 0 if the format
+// is not recognized.
+size_t qtr_unpack_frame(const unsigned char *frame, int format,
+						int num_sensors, unsigned int *values);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
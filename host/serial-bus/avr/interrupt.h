@@ -0,0 +1,24 @@
+/*
+ * avr/interrupt.h - Stand-in for the avr-libc header.  Each bus node runs
+ * in its own single-threaded process, so interrupts are simply calls made
+ * by the event loop and disabling them does nothing.
+ */
+
+#ifndef host_interrupt_h
+#define host_interrupt_h
+
+extern unsigned char SREG;
+
+static inline void cli(void) { }
+static inline void sei(void) { }
+
+#define ISR(vector)	void vector(void)
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
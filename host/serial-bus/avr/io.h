@@ -0,0 +1,31 @@
+/*
+ * avr/io.h - Stand-in for the avr-libc header so that OrangutanSerialBus
+ * can run on the PC.  The UART registers are emulated by
+ * serial-bus-test.cpp: writing UDR0 sends a byte to the pty hub, and the
+ * data register is always ready for another byte.
+ */
+
+#ifndef host_io_h
+#define host_io_h
+
+#define TXC0	6
+#define UDRE0	5
+#define TXCIE0	6
+
+extern unsigned char UCSR0A, UCSR0B;
+
+class HostUartData
+{
+  public:
+	HostUartData &operator=(unsigned char byte);
+};
+extern HostUartData UDR0;
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
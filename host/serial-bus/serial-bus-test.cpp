@@ -0,0 +1,437 @@
+/*
+ * serial-bus-test.cpp - Runs the OrangutanSerialBus frame, CRC and
+ * polling state machine on the PC: one master and several slaves, each
+ * in its own process, connected through a pty hub that acts as the
+ * shared half-duplex bus.  The hub sends every byte to every node
+ * (including the sender, like an RS-485 transceiver with its receiver
+ * enabled), one byte time apart.  The master polls the slaves in turn
+ * and checks every reply, and the test reports polls and frames per
+ * second of bus time.
+ *
+ * Time on the bus is simulated: the hub and the nodes share a clock that
+ * advances one byte time at a time, and every node handles the bytes of
+ * one step before the next.  That way the results do not depend on how
+ * busy the PC is.
+ *
+ * Usage: serial-bus-test [-n slaves] [-b baud] [-t seconds]
+ *                        [-p poll bytes] [-r reply bytes]
+ *
+ * Exits with status 1 if any reply is missing or wrong.
+ */
+
+#include <fcntl.h>
+#include <sched.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/wait.h>
+#include <termios.h>
+#include <time.h>
+#include <unistd.h>
+
+#define MAX_NODES	65
+
+// The state shared by the hub and the nodes.
+struct Bus
+{
+	volatile unsigned long long time_ns;	// simulated time
+	volatile unsigned long step;			// advanced by the hub
+	volatile unsigned long done[MAX_NODES];	// last step each node finished
+	volatile unsigned long sent[MAX_NODES];		// bytes each node has written
+	volatile unsigned long delivered;		// bytes the hub has sent to every node
+	volatile unsigned char stop;
+};
+
+static struct Bus *bus;
+
+/** STAND-INS FOR THE REST OF THE LIBRARY *************************************/
+
+// Keep the real headers out; OrangutanSerialBus only needs these parts.
+#define OrangutanSerial_h
+#define OrangutanDigital_h
+#define OrangutanTime_h
+
+#define SERIAL_AUTOMATIC	0
+#define LOW					0
+
+struct IOStruct
+{
+	volatile unsigned char *pinRegister;
+	volatile unsigned char *portRegister;
+	volatile unsigned char *ddrRegister;
+	unsigned char bitmask;
+};
+
+class OrangutanTime
+{
+  public:
+	static unsigned long ms() { return bus->time_ns / 1000000; }
+	static void delayMicroseconds(unsigned int) { }	// short next to a byte time
+	static void idle() { }
+};
+
+static volatile unsigned char dePort;
+
+class OrangutanDigital
+{
+  public:
+	static void setOutput(unsigned char, unsigned char) { }
+	static void getIORegisters(struct IOStruct *io, unsigned char)
+	{
+		io->portRegister = &dePort;
+		io->bitmask = 1;
+	}
+};
+
+static void (*receiveHook)(unsigned char);
+
+template<unsigned char port> class SerialPort
+{
+  public:
+	static void setMode(unsigned char) { }
+	static void setBaudRate(unsigned long) { }
+	static void setReceiveHook(void (*hook)(unsigned char)) { receiveHook = hook; }
+};
+
+#include "avr/io.h"
+#include "avr/interrupt.h"
+
+/** EMULATED UART *************************************************************/
+
+unsigned char SREG;
+unsigned char UCSR0A = 1 << UDRE0;
+unsigned char UCSR0B;
+HostUartData UDR0;
+
+static unsigned char node;
+static int busFd;
+static unsigned int echoesPending;	// bytes sent that the hub has not echoed yet
+
+HostUartData &HostUartData::operator=(unsigned char byte)
+{
+	if (write(busFd, &byte, 1) != 1)
+	{
+		perror("write");
+		exit(2);
+	}
+	bus->sent[node]++;
+	echoesPending++;
+	return *this;
+}
+
+#include "../../src/OrangutanSerialBus/OrangutanSerialBus.cpp"
+
+// Fires the TX complete interrupt once everything this node sent has
+// come back from the hub, which means its last stop bit is over.
+static void checkTransmitComplete()
+{
+	if (echoesPending == 0 && (UCSR0B & (1 << TXCIE0)))
+		OrangutanSerialBus::transmitInterrupt();
+}
+
+// Waits for the hub to start the next step, then delivers the bytes it
+// sent in that step, like the RX interrupt.  Returns 0 when the test is
+// over.
+static unsigned char nextStep()
+{
+	static unsigned long received;
+
+	bus->done[node] = bus->step;
+	while (bus->done[node] == bus->step)
+	{
+		if (bus->stop)
+			return 0;
+		sched_yield();
+	}
+
+	while (received < bus->delivered)
+	{
+		unsigned char byte;
+		if (read(busFd, &byte, 1) != 1)
+		{
+			perror("read");
+			exit(2);
+		}
+		received++;
+
+		// Check first: the hook may start sending a reply.
+		unsigned char echo = echoesPending != 0;
+		receiveHook(byte);
+		if (echo)
+			echoesPending--;
+	}
+	checkTransmitComplete();
+	return 1;
+}
+
+/** NODES *********************************************************************/
+
+static void fillReply(char *reply, unsigned char address, unsigned char size, unsigned char sequence)
+{
+	for (unsigned char i = 0; i < size; i++)
+		reply[i] = address * 16 + i + sequence;
+}
+
+static void runSlave(unsigned long baud, unsigned char replySize)
+{
+	char poll[SERIAL_BUS_MAX_DATA];
+	char reply[SERIAL_BUS_MAX_DATA];
+	unsigned char sequence = 0, newSequence = 0;
+
+	OrangutanSerialBus::init(node, baud, 0);
+	OrangutanSerialBus::receive(poll, sizeof(poll));
+
+	while (nextStep())
+	{
+		// The first poll byte is a sequence number.  The reply to the
+		// next poll carries data made from it, so stale replies are
+		// caught.
+		if (OrangutanSerialBus::frameReceived())
+		{
+			if (OrangutanSerialBus::getReceivedBytes())
+			{
+				sequence = poll[0];
+				newSequence = 1;
+			}
+			OrangutanSerialBus::receive(poll, sizeof(poll));
+		}
+
+		if (newSequence && OrangutanSerialBus::replySent())
+		{
+			fillReply(reply, node, replySize, sequence + 1);
+			OrangutanSerialBus::setReply(reply, replySize);
+			newSequence = 0;
+		}
+	}
+}
+
+static int runMaster(unsigned char slaves, unsigned long baud, unsigned int seconds,
+					 unsigned char pollSize, unsigned char replySize)
+{
+	char poll[SERIAL_BUS_MAX_DATA];
+	char reply[SERIAL_BUS_MAX_DATA];
+	char expected[SERIAL_BUS_MAX_DATA];
+	unsigned char lastSequence[MAX_NODES] = { 0 };
+	unsigned long done = 0, timeouts = 0, wrong = 0, missing = 0;
+	unsigned char next = 1, sequence = 0, polling = 0, firstRound = 1;
+
+	OrangutanSerialBus::init(0, baud, 0);
+
+	while (nextStep())
+	{
+		if (polling)
+		{
+			unsigned char status = OrangutanSerialBus::getStatus();
+			if (status == SERIAL_BUS_BUSY)
+				continue;
+
+			// After the slaves, each round polls an address nobody has,
+			// which must time out.  A slave answers its first poll with
+			// an empty reply, since it has not seen a sequence number
+			// yet.
+			if (next > slaves)
+			{
+				if (status == SERIAL_BUS_TIMEOUT)
+					missing++;
+				else
+					wrong++;
+			}
+			else if (status == SERIAL_BUS_TIMEOUT)
+				timeouts++;
+			else if (OrangutanSerialBus::getReceivedSource() != next)
+				wrong++;
+			else if (firstRound)
+				done++;
+			else if (OrangutanSerialBus::getReceivedBytes() != replySize ||
+					 memcmp(reply, expected, replySize))
+				wrong++;
+			else
+				done++;
+
+			polling = 0;
+			if (++next > slaves + 1)
+			{
+				next = 1;
+				firstRound = 0;
+			}
+		}
+
+		if (bus->time_ns >= seconds * 1000000000ULL)
+			break;
+
+		memset(poll, 0, sizeof(poll));
+		poll[0] = ++sequence;
+		fillReply(expected, next, replySize, lastSequence[next] + 1);
+		lastSequence[next] = sequence;
+
+		OrangutanSerialBus::receive(reply, sizeof(reply));
+		OrangutanSerialBus::poll(next, poll, pollSize);
+		polling = 1;
+	}
+
+	double elapsed = bus->time_ns / 1e9;
+	printf("%u slaves at %lu baud, %u-byte polls, %u-byte replies, %.1f s\n",
+		   slaves, baud, pollSize, replySize, elapsed);
+	printf("  %lu replies, %lu timeouts, %lu wrong, %u frame errors, %lu polls of a missing node\n",
+		   done, timeouts, wrong, OrangutanSerialBus::getErrorCount(), missing);
+	printf("  %.1f replies/s, %.1f frames/s, bus %.0f%% busy\n",
+		   done / elapsed, (2 * done + missing) / elapsed, 100.0 * bus->delivered * 10 / baud / elapsed);
+
+	return (timeouts || wrong || !missing || OrangutanSerialBus::getErrorCount()) ? 1 : 0;
+}
+
+/** HUB ***********************************************************************/
+
+static int openPty(int *slaveFd)
+{
+	int master = posix_openpt(O_RDWR | O_NOCTTY);
+	if (master < 0 || grantpt(master) || unlockpt(master))
+		return -1;
+	*slaveFd = open(ptsname(master), O_RDWR | O_NOCTTY);
+	if (*slaveFd < 0)
+		return -1;
+
+	struct termios t;
+	tcgetattr(master, &t);
+	cfmakeraw(&t);
+	tcsetattr(master, TCSANOW, &t);
+	tcgetattr(*slaveFd, &t);
+	cfmakeraw(&t);
+	tcsetattr(*slaveFd, TCSANOW, &t);
+	return master;
+}
+
+int main(int argc, char **argv)
+{
+	unsigned int slaves = 8, seconds = 2, pollSize = 4, replySize = 16;
+	unsigned long baud = 115200;
+	int c;
+
+	while ((c = getopt(argc, argv, "n:b:t:p:r:")) != -1)
+	{
+		switch (c)
+		{
+		case 'n': slaves = atoi(optarg); break;
+		case 'b': baud = atol(optarg); break;
+		case 't': seconds = atoi(optarg); break;
+		case 'p': pollSize = atoi(optarg); break;
+		case 'r': replySize = atoi(optarg); break;
+		default:
+			fprintf(stderr, "usage: serial-bus-test [-n slaves] [-b baud] [-t seconds] [-p poll bytes] [-r reply bytes]\n");
+			return 2;
+		}
+	}
+	if (slaves < 1 || slaves >= MAX_NODES || baud < 300 || seconds < 1 ||
+		pollSize < 1 || pollSize > SERIAL_BUS_MAX_DATA || replySize > SERIAL_BUS_MAX_DATA)
+	{
+		fprintf(stderr, "serial-bus-test: bad arguments\n");
+		return 2;
+	}
+
+	bus = (struct Bus *)mmap(0, sizeof(struct Bus), PROT_READ | PROT_WRITE,
+							 MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+	if (bus == MAP_FAILED)
+	{
+		perror("mmap");
+		return 2;
+	}
+
+	// node 0 is the master, nodes 1 to slaves are the slaves
+	unsigned int nodes = slaves + 1;
+	int hubFd[MAX_NODES];
+	pid_t pid[MAX_NODES];
+
+	for (unsigned int i = 0; i < nodes; i++)
+	{
+		int slaveFd;
+		hubFd[i] = openPty(&slaveFd);
+		if (hubFd[i] < 0)
+		{
+			perror("pty");
+			return 2;
+		}
+
+		pid[i] = fork();
+		if (pid[i] == 0)
+		{
+			for (unsigned int j = 0; j <= i; j++)
+				close(hubFd[j]);
+			node = i;
+			busFd = slaveFd;
+			if (i == 0)
+			{
+				int result = runMaster(slaves, baud, seconds, pollSize, replySize);
+				bus->stop = 1;
+				exit(result);
+			}
+			runSlave(baud, replySize);
+			exit(0);
+		}
+		close(slaveFd);
+	}
+
+	// Each step is one byte time.  The hub collects what the nodes wrote
+	// in the last step, forwards at most one byte to everyone, and
+	// starts the next step when all nodes have finished this one.
+	static unsigned char queue[65536];
+	unsigned int head = 0, tail = 0;
+	unsigned long taken[MAX_NODES] = { 0 };
+	unsigned long byteTime = 10000000000ULL / baud;
+
+	while (!bus->stop)
+	{
+		for (unsigned int i = 0; i < nodes; i++)
+		{
+			while (taken[i] < bus->sent[i])
+			{
+				if (read(hubFd[i], &queue[head & 0xFFFF], 1) != 1)
+				{
+					perror("read");
+					return 2;
+				}
+				head++;
+				taken[i]++;
+			}
+		}
+
+		if (head != tail)
+		{
+			unsigned char byte = queue[tail++ & 0xFFFF];
+			for (unsigned int i = 0; i < nodes; i++)
+			{
+				if (write(hubFd[i], &byte, 1) != 1)
+				{
+					perror("write");
+					return 2;
+				}
+			}
+			bus->delivered++;
+		}
+
+		bus->time_ns += byteTime;
+		unsigned long step = ++bus->step;
+		for (unsigned int i = 0; i < nodes && !bus->stop; i++)
+		{
+			while (bus->done[i] != step && !bus->stop)
+				sched_yield();
+		}
+	}
+
+	int status = 2;
+	waitpid(pid[0], &status, 0);
+	for (unsigned int i = 1; i < nodes; i++)
+		kill(pid[i], SIGTERM);
+	while (wait(0) > 0)
+		;
+
+	return WIFEXITED(status) ? WEXITSTATUS(status) : 2;
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,29 @@
+/*
+ * util/crc16.h - Stand-in for the avr-libc header, with the same
+ * CRC-16-CCITT (XMODEM) update function.
+ */
+
+#ifndef host_crc16_h
+#define host_crc16_h
+
+static inline unsigned short _crc_xmodem_update(unsigned short crc, unsigned char data)
+{
+	crc = crc ^ ((unsigned short)data << 8);
+	for (int i = 0; i < 8; i++)
+	{
+		if (crc & 0x8000)
+			crc = (crc << 1) ^ 0x1021;
+		else
+			crc <<= 1;
+	}
+	return crc;
+}
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
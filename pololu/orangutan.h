@@ -15,4 +15,16 @@
 #include "OrangutanSVP/OrangutanSVP.h"
 #include "OrangutanX2/OrangutanX2.h"
 #include "OrangutanSPIMaster/OrangutanSPIMaster.h"
+#include "OrangutanScheduler/OrangutanScheduler.h"
+#include "OrangutanWatchdog/OrangutanWatchdog.h"
+#include "OrangutanEEPROMLog/OrangutanEEPROMLog.h"
+#include "PololuFixedMath/PololuFixedMath.h"
+#include "PololuOdometry/PololuOdometry.h"
+#include "PololuPurePursuit/PololuPurePursuit.h"
+#include "OrangutanStepper/OrangutanStepper.h"
+#include "OrangutanI2CMaster/OrangutanI2CMaster.h"
+#include "OrangutanSoftSerial/OrangutanSoftSerial.h"
+#include "OrangutanSerialBus/OrangutanSerialBus.h"
+#include "OrangutanCurrentMonitor/OrangutanCurrentMonitor.h"
+#include "OrangutanProfiler/OrangutanProfiler.h"
 #include "workaround.h"
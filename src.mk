@@ -140,3 +140,22 @@ clean_examples:
 			$(MAKE) clean -C $$dir; \
 		done; \
 	fi
+
+# lto_size_report: A phony target that links one example against both the
+# normal and the link-time-optimized library and prints the sizes of the
+# resulting programs, e.g.
+#   make lto_size_report LTO_REPORT_EXAMPLE=3pi-linefollower-pid LTO_REPORT_DEVICE=atmega328p
+LTO_REPORT_EXAMPLE ?= simple-test
+LTO_REPORT_DEVICE ?= atmega328p
+lto_report_dir = examples/$(LTO_REPORT_DEVICE)/$(LTO_REPORT_EXAMPLE)
+lto_report_cflags = -g -Wall -mcall-prologues -mmcu=$$(MCU) $$(DEVICE_SPECIFIC_CFLAGS) -Os -I$(CURDIR) -I$(CURDIR)/src
+
+.PHONY: lto_size_report
+lto_size_report: library_files lto_library_files
+	examples_templates/prepare.sh $(LTO_REPORT_EXAMPLE) $(LTO_REPORT_DEVICE) $(mcu_$(LTO_REPORT_DEVICE)) '$(device_specific_macro_$(LTO_REPORT_DEVICE))'
+	$(MAKE) -C $(lto_report_dir) clean all 'CFLAGS=$(lto_report_cflags)' 'LDFLAGS=-Wl,-gc-sections -L$(CURDIR) -lpololu_$(LTO_REPORT_DEVICE) -Wl,-relax'
+	@echo "== $(LTO_REPORT_EXAMPLE) with libpololu_$(LTO_REPORT_DEVICE).a"
+	avr-size $(lto_report_dir)/test.obj
+	$(MAKE) -C $(lto_report_dir) clean all 'CFLAGS=$(lto_report_cflags) -flto' 'LDFLAGS=-flto -Wl,-gc-sections -L$(CURDIR) -lpololu_$(LTO_REPORT_DEVICE)_lto -Wl,-relax'
+	@echo "== $(LTO_REPORT_EXAMPLE) with libpololu_$(LTO_REPORT_DEVICE)_lto.a"
+	avr-size $(lto_report_dir)/test.obj
@@ -25,6 +25,9 @@
 
 #include <avr/io.h>
 #include "OrangutanAnalog.h"
+#ifdef _ORANGUTAN_SVP
+#include "../OrangutanTime/OrangutanTime.h"	// only the SVP averaging waits on ms()
+#endif
 
 #include "../OrangutanResources/include/OrangutanModel.h"
 
@@ -91,6 +94,11 @@ extern "C" unsigned int read_trimpot_millivolts()
 
 #ifdef _ORANGUTAN_SVP
 
+extern "C" void set_aux_averaging(unsigned char samples)
+{
+	OrangutanAnalog::setAuxAveraging(samples);
+}
+
 extern "C" unsigned int read_battery_millivolts_svp()
 {
 	return OrangutanAnalog::readBatteryMillivolts_SVP();
@@ -151,6 +159,15 @@ static unsigned char adc_result_is_in_millivolts = 0;
         is non-zero.  David wanted to just store it in ADCL and ADCH, but those
 		registers are not writable. */
 static unsigned int adc_result_millivolts;
+
+// non-zero when setAuxAveraging() has turned on background averaging
+static unsigned char aux_averaging = 0;
+
+// Converts TRIMPOT or CHANNEL_A-D to the auxiliary processor's SVP_AUX_* index.
+static inline unsigned char aux_index(unsigned char channel)
+{
+	return channel == TRIMPOT ? SVP_AUX_TRIMPOT : channel - CHANNEL_A;
+}
 #endif
 
 static unsigned int millivolt_calibration = 5000;	// contains VCC in millivolts
@@ -221,11 +238,13 @@ void OrangutanAnalog::startConversion(unsigned char channel, unsigned char use_i
 	{
 		adc_result_is_in_millivolts = 1;
 
-		if (channel == TRIMPOT){ adc_result_millivolts = OrangutanSVP::getTrimpotMillivolts(); }
-		else if (channel == CHANNEL_A){ adc_result_millivolts = OrangutanSVP::getChannelAMillivolts(); }
-		else if (channel == CHANNEL_B){ adc_result_millivolts = OrangutanSVP::getChannelBMillivolts(); }
-		else if (channel == CHANNEL_C){ adc_result_millivolts = OrangutanSVP::getChannelCMillivolts(); }
-		else if (channel == CHANNEL_D){ adc_result_millivolts = OrangutanSVP::getChannelDMillivolts(); }
+		if (channel >= TRIMPOT && channel <= CHANNEL_D)
+		{
+			if (aux_averaging)
+				adc_result_millivolts = OrangutanSVP::getAverageMillivolts(aux_index(channel));
+			else
+				adc_result_millivolts = OrangutanSVP::getAuxMillivolts(aux_index(channel));
+		}
 
 		return;
 	}
@@ -305,9 +324,7 @@ unsigned int OrangutanAnalog::readAverage(unsigned char channel,
 #ifdef _ORANGUTAN_SVP
 	if (channel > 31)
 	{
-		// We have not implemented averaging of the adc readings from the auxiliary
-		// processor on the SVP, so we will just return a simple reading.
-		return read(channel);
+		return fromMillivoltsToNormal(readAverageMillivolts_SVP(channel, samples));
 	}
 #endif
 
@@ -326,6 +343,46 @@ unsigned int OrangutanAnalog::readAverage(unsigned char channel,
 }
 
 
+#ifdef _ORANGUTAN_SVP
+// Averages successive snapshots of the auxiliary processor's readings.
+// Each snapshot costs one SPI transfer of all the variables, and the
+// library takes at most one per millisecond, so we wait for the
+// millisecond counter to change between samples.
+unsigned int OrangutanAnalog::readAverageMillivolts_SVP(unsigned char channel, unsigned int samples)
+{
+	if (channel < TRIMPOT || channel > CHANNEL_D || samples == 0)
+	{
+		return 0;
+	}
+
+	unsigned char index = aux_index(channel);
+	unsigned long sum = 0;
+	unsigned int i = samples;
+	while (1)
+	{
+		sum += OrangutanSVP::getAuxMillivolts(index);
+		if (--i == 0)
+		{
+			break;
+		}
+
+		unsigned long last_ms = OrangutanTime::ms();
+		while (OrangutanTime::ms() == last_ms)
+		{
+			OrangutanTime::idle();
+		}
+	}
+
+	return (sum + (samples >> 1)) / samples;
+}
+
+void OrangutanAnalog::setAuxAveraging(unsigned char samples)
+{
+	OrangutanSVP::setAveraging(samples);
+	aux_averaging = samples > 1;
+}
+#endif
+
 // sets the value used to calibrate the conversion from ADC reading
 // to millivolts.  The argument calibration should equal VCC in millivolts,
 // which can be automatically measured using the function readVCCMillivolts():
@@ -98,28 +98,53 @@ class OrangutanAnalog
 	#ifdef _ORANGUTAN_SVP
 		if (channel > 31)
 		{
-			// We have not implemented averaging of the adc readings from the auxiliary
-			// processor on the SVP, so we will just return a simple reading.
-			return readMillivolts(channel);
+			return readAverageMillivolts_SVP(channel, samples);
 		}
 	#endif
 		return toMillivolts(readAverage(channel, samples));
 	}
-	
+
+#ifdef _ORANGUTAN_SVP
+	// SVP: averages 'samples' successive readings of an auxiliary channel
+	// (TRIMPOT or CHANNEL_A-D) and returns the result in millivolts.  The
+	// auxiliary processor's readings are fetched at most once per
+	// millisecond, so this takes about 'samples' milliseconds; the idle
+	// function (see OrangutanTime::setIdleFunction) runs while it waits.
+	static unsigned int readAverageMillivolts_SVP(unsigned char channel, unsigned int samples);
+
+	// SVP: turns on background averaging of the auxiliary channels over
+	// 'samples' successive readings (2-255), or turns it off (0).  While it
+	// is on, read(), readMillivolts() and startConversion() return the
+	// latest average for TRIMPOT and CHANNEL_A-D instead of a single
+	// reading, so these channels can be read along with the AVR's own ADC
+	// channels at no extra cost.  The averages advance whenever the
+	// library reads from the auxiliary processor, at most once per
+	// millisecond; call OrangutanSVP::updateAnalog() regularly if nothing
+	// else does.
+	static void setAuxAveraging(unsigned char samples);
+#endif
+
 	// returns the position of the trimpot (20 readings averaged together).
 	// For all devices except the Orangutan SVP, the trimpot is on ADC channel 7.
 	// On the Orangutan SVP, the trimpot is on the auxiliary processor, so 
 	// calling this function can have side effects related to enabling SPI
-	// communication (see the SVP user's guide for more info).
+	// communication (see the SVP user's guide for more info).  On the SVP
+	// this returns a single reading, or the background average if
+	// setAuxAveraging() has turned it on; use readAverage(TRIMPOT, 20) for
+	// a 20-reading average, which takes 20 ms.
 	static inline unsigned int readTrimpot()
 	{
+	#ifdef _ORANGUTAN_SVP
+		return read(TRIMPOT);
+	#else
 		return readAverage(TRIMPOT, 20);
+	#endif
 	}
 
 	static inline unsigned int readTrimpotMillivolts()
 	{
 	#ifdef _ORANGUTAN_SVP
-		return OrangutanSVP::getTrimpotMillivolts();
+		return readMillivolts(TRIMPOT);
 	#else
 		return toMillivolts(readTrimpot());
 	#endif
@@ -257,6 +282,7 @@ unsigned int read_trimpot_millivolts(void);
 
 #ifdef _ORANGUTAN_SVP
 
+void set_aux_averaging(unsigned char samples);
 unsigned int read_battery_millivolts_svp(void);
 static inline unsigned int read_battery_millivolts(void)
 {
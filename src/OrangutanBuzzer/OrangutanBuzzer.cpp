@@ -38,6 +38,9 @@
 #include <avr/pgmspace.h>
 #include "OrangutanBuzzer.h"
 #include "../OrangutanResources/include/OrangutanModel.h"
+#ifndef ARDUINO
+#include "../OrangutanProfiler/OrangutanProfiler.h"
+#endif
 #ifdef _ORANGUTAN_X2
 #include "../OrangutanX2/OrangutanX2.h"
 #endif
@@ -570,6 +573,10 @@ static unsigned int getNumber()
 
 static void nextNote()
 {
+#ifndef ARDUINO
+	PROFILE_SCOPE(buzzer_next_note);
+#endif
+
 	unsigned char note = 0;
 	unsigned char rest = 0;
 	unsigned char tmp_octave = octave; // the octave for this note
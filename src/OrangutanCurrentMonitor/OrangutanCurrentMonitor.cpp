@@ -0,0 +1,198 @@
+/*
+  OrangutanCurrentMonitor.cpp - Background motor current monitor for the
+      Orangutan X2: samples both motors' current, filters it, tracks peaks
+      and reports overcurrent events.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#include "../OrangutanResources/include/OrangutanModel.h"
+
+#ifdef _ORANGUTAN_X2
+
+#include "OrangutanCurrentMonitor.h"
+#include "../OrangutanX2/OrangutanX2.h"
+#include "../OrangutanScheduler/OrangutanScheduler.h"
+
+unsigned int OrangutanCurrentMonitor::filtered[2];
+unsigned char OrangutanCurrentMonitor::lastSample[2];
+unsigned char OrangutanCurrentMonitor::peak[2];
+unsigned char OrangutanCurrentMonitor::threshold[2];
+unsigned char OrangutanCurrentMonitor::overcurrent;
+unsigned char OrangutanCurrentMonitor::events;
+unsigned char OrangutanCurrentMonitor::shift;
+unsigned int OrangutanCurrentMonitor::sampleCount;
+void (*OrangutanCurrentMonitor::overcurrentCallback)(unsigned char motor, unsigned char current);
+
+extern "C" unsigned char current_monitor_init(unsigned int period_ms, unsigned char filter_shift)
+{
+	return OrangutanCurrentMonitor::init(period_ms, filter_shift);
+}
+
+extern "C" void current_monitor_stop()
+{
+	OrangutanCurrentMonitor::stop();
+}
+
+extern "C" unsigned char current_monitor_get_current(unsigned char motor)
+{
+	return OrangutanCurrentMonitor::getCurrent(motor);
+}
+
+extern "C" unsigned char current_monitor_get_last_sample(unsigned char motor)
+{
+	return OrangutanCurrentMonitor::getLastSample(motor);
+}
+
+extern "C" unsigned char current_monitor_get_peak(unsigned char motor)
+{
+	return OrangutanCurrentMonitor::getPeak(motor);
+}
+
+extern "C" void current_monitor_reset_peaks()
+{
+	OrangutanCurrentMonitor::resetPeaks();
+}
+
+extern "C" void current_monitor_set_threshold(unsigned char motor, unsigned char threshold)
+{
+	OrangutanCurrentMonitor::setThreshold(motor, threshold);
+}
+
+extern "C" unsigned char current_monitor_get_overcurrent_events()
+{
+	return OrangutanCurrentMonitor::getOvercurrentEvents();
+}
+
+extern "C" unsigned char current_monitor_is_overcurrent(unsigned char motor)
+{
+	return OrangutanCurrentMonitor::isOvercurrent(motor);
+}
+
+extern "C" void current_monitor_set_overcurrent_callback(void (*callback)(unsigned char motor, unsigned char current))
+{
+	OrangutanCurrentMonitor::setOvercurrentCallback(callback);
+}
+
+extern "C" unsigned int current_monitor_get_sample_count()
+{
+	return OrangutanCurrentMonitor::getSampleCount();
+}
+
+extern "C" void current_monitor_update()
+{
+	OrangutanCurrentMonitor::update();
+}
+
+
+unsigned char OrangutanCurrentMonitor::init(unsigned int period_ms, unsigned char filter_shift)
+{
+	if (filter_shift > 7)
+		filter_shift = 7;
+	shift = filter_shift;
+
+	for (unsigned char i = 0; i < 2; i++)
+	{
+		filtered[i] = 0;
+		lastSample[i] = 0;
+		peak[i] = 0;
+	}
+	overcurrent = 0;
+	events = 0;
+	sampleCount = 0;
+
+	// Sampling is cheap (two short SPI commands), so it runs ahead of
+	// ordinary tasks to keep the sample rate steady.
+	return OrangutanScheduler::addTask(update, period_ms, 0);
+}
+
+void OrangutanCurrentMonitor::stop()
+{
+	OrangutanScheduler::removeTask(update);
+}
+
+void OrangutanCurrentMonitor::resetPeaks()
+{
+	peak[0] = 0;
+	peak[1] = 0;
+}
+
+void OrangutanCurrentMonitor::setThreshold(unsigned char motor, unsigned char new_threshold)
+{
+	motor &= 1;
+	threshold[motor] = new_threshold;
+	if (new_threshold == 0)
+		overcurrent &= ~(1 << motor);
+}
+
+unsigned char OrangutanCurrentMonitor::getOvercurrentEvents()
+{
+	unsigned char e = events;
+	events = 0;
+	return e;
+}
+
+void OrangutanCurrentMonitor::update()
+{
+	for (unsigned char motor = 0; motor < 2; motor++)
+	{
+		unsigned char sample = OrangutanX2::getMotorCurrent(motor);
+		lastSample[motor] = sample;
+		if (sample > peak[motor])
+			peak[motor] = sample;
+
+		// Exponential moving average in 8.8 fixed point.  The first
+		// sample after init() seeds the average so it does not have to
+		// climb up from zero.
+		unsigned int target = (unsigned int)sample << 8;
+		if (sampleCount == 0)
+			filtered[motor] = target;
+		else if (target > filtered[motor])
+			filtered[motor] += (target - filtered[motor]) >> shift;
+		else
+			filtered[motor] -= (filtered[motor] - target) >> shift;
+
+		unsigned char current = filtered[motor] >> 8;
+		unsigned char bit = 1 << motor;
+		if (threshold[motor] && current >= threshold[motor])
+		{
+			if (!(overcurrent & bit))
+			{
+				overcurrent |= bit;
+				events |= bit;
+				if (overcurrentCallback)
+					overcurrentCallback(motor, current);
+			}
+		}
+		else
+			overcurrent &= ~bit;
+	}
+	sampleCount++;
+}
+
+#endif // _ORANGUTAN_X2
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
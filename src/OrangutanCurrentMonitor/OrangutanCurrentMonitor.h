@@ -0,0 +1,160 @@
+/*
+  OrangutanCurrentMonitor.h - Background motor current monitor for the
+      Orangutan X2: samples both motors' current, filters it, tracks peaks
+      and reports overcurrent events.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#ifndef OrangutanCurrentMonitor_h
+#define OrangutanCurrentMonitor_h
+
+#include "../OrangutanResources/include/OrangutanModel.h"
+
+#ifdef _ORANGUTAN_X2
+
+// Bits returned by getOvercurrentEvents().
+#define CURRENT_MONITOR_M1_OVERCURRENT	(1 << 0)
+#define CURRENT_MONITOR_M2_OVERCURRENT	(1 << 1)
+
+#ifdef __cplusplus
+
+class OrangutanCurrentMonitor
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	OrangutanCurrentMonitor() { }
+
+	// Starts sampling both motors' current (with
+	// OrangutanX2::getMotorCurrent()) every period_ms milliseconds as an
+	// OrangutanScheduler task, so the samples are taken while your
+	// program waits in delay_ms() or other blocking library calls, or
+	// whenever it calls OrangutanScheduler::run().  Each sample is
+	// folded into an exponential moving average that moves 1/2^filter_shift
+	// of the way towards the new sample (0 means no filtering, 7 is the
+	// most).  Clears the averages, peaks and pending events.  Returns 1
+	// on success, or 0 if the scheduler has no free task slot.
+	static unsigned char init(unsigned int period_ms, unsigned char filter_shift);
+
+	// Stops sampling.  The last values stay available.
+	static void stop();
+
+	// Returns the filtered current of MOTOR1 or MOTOR2, in the same units
+	// as OrangutanX2::getMotorCurrent() (0 - 255).
+	static inline unsigned char getCurrent(unsigned char motor)
+	{
+		return filtered[motor & 1] >> 8;
+	}
+
+	// Returns the most recent unfiltered sample of the given motor.
+	static inline unsigned char getLastSample(unsigned char motor)
+	{
+		return lastSample[motor & 1];
+	}
+
+	// Returns the highest unfiltered sample of the given motor since
+	// init() or the last call to resetPeaks().
+	static inline unsigned char getPeak(unsigned char motor)
+	{
+		return peak[motor & 1];
+	}
+
+	static void resetPeaks();
+
+	// Sets the filtered current at or above which the given motor is
+	// considered overcurrent (0, the default, disables the check).  An
+	// event is raised each time the filtered current rises to the
+	// threshold; the motor must drop below it again before the next one.
+	static void setThreshold(unsigned char motor, unsigned char threshold);
+
+	// Returns the CURRENT_MONITOR_Mx_OVERCURRENT bits of the events that
+	// happened since the last call, and clears them.
+	static unsigned char getOvercurrentEvents();
+
+	// Returns 1 if the given motor's filtered current is currently at or
+	// above its threshold.
+	static inline unsigned char isOvercurrent(unsigned char motor)
+	{
+		return (overcurrent >> (motor & 1)) & 1;
+	}
+
+	// Registers a function to call from the monitor task when a motor
+	// becomes overcurrent, with the motor and its filtered current, so
+	// protection (e.g. braking the motor) does not have to wait for the
+	// main loop.  Pass 0 to remove it.
+	static inline void setOvercurrentCallback(void (*callback)(unsigned char motor, unsigned char current))
+	{
+		overcurrentCallback = callback;
+	}
+
+	// Returns the number of times both motors have been sampled (wraps
+	// around at 65535), so you can tell when new data is available.
+	static inline unsigned int getSampleCount() { return sampleCount; }
+
+	// Takes one sample of both motors.  This is the OrangutanScheduler
+	// task; you only need to call it yourself if you do not use the
+	// scheduler.
+	static void update();
+
+  private:
+
+	static unsigned int filtered[2];		// 8.8 fixed point
+	static unsigned char lastSample[2];
+	static unsigned char peak[2];
+	static unsigned char threshold[2];
+	static unsigned char overcurrent;		// bit per motor, current state
+	static unsigned char events;			// bit per motor, latched
+	static unsigned char shift;
+	static unsigned int sampleCount;
+	static void (*overcurrentCallback)(unsigned char motor, unsigned char current);
+};
+
+extern "C" {
+#endif // __cplusplus
+
+unsigned char current_monitor_init(unsigned int period_ms, unsigned char filter_shift);
+void current_monitor_stop(void);
+unsigned char current_monitor_get_current(unsigned char motor);
+unsigned char current_monitor_get_last_sample(unsigned char motor);
+unsigned char current_monitor_get_peak(unsigned char motor);
+void current_monitor_reset_peaks(void);
+void current_monitor_set_threshold(unsigned char motor, unsigned char threshold);
+unsigned char current_monitor_get_overcurrent_events(void);
+unsigned char current_monitor_is_overcurrent(unsigned char motor);
+void current_monitor_set_overcurrent_callback(void (*callback)(unsigned char motor, unsigned char current));
+unsigned int current_monitor_get_sample_count(void);
+void current_monitor_update(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif // _ORANGUTAN_X2
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,330 @@
+/*
+  OrangutanEEPROMLog.cpp - Ring log that stores fixed-size binary records in
+      the AVR's EEPROM, written in the background from a RAM staging buffer.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#include "OrangutanEEPROMLog.h"
+#include "../OrangutanTime/OrangutanTime.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <string.h>
+
+#define EEPROM_LOG_ERASED	0xFFFF	// sequence number of a slot that was never written
+
+unsigned int OrangutanEEPROMLog::start;
+unsigned int OrangutanEEPROMLog::slots = 0;
+unsigned char OrangutanEEPROMLog::recordSize;
+unsigned char *OrangutanEEPROMLog::buffer;
+unsigned char OrangutanEEPROMLog::bufferRecords;
+volatile unsigned char OrangutanEEPROMLog::bufferHead = 0;
+volatile unsigned char OrangutanEEPROMLog::bufferTail = 0;
+volatile unsigned char OrangutanEEPROMLog::writeOffset = 0;
+volatile unsigned int OrangutanEEPROMLog::nextSlot;
+volatile unsigned int OrangutanEEPROMLog::nextSequence;
+volatile unsigned int OrangutanEEPROMLog::count = 0;
+unsigned int OrangutanEEPROMLog::droppedRecords = 0;
+
+extern "C" void eeprom_log_init(unsigned int start, unsigned int size, unsigned char record_size,
+	unsigned char *buffer, unsigned char buffer_records)
+{
+	OrangutanEEPROMLog::init(start, size, record_size, buffer, buffer_records);
+}
+
+extern "C" unsigned char eeprom_log_append(const void *record)
+{
+	return OrangutanEEPROMLog::append(record);
+}
+
+extern "C" unsigned int eeprom_log_get_count()
+{
+	return OrangutanEEPROMLog::getCount();
+}
+
+extern "C" unsigned int eeprom_log_get_dropped_records()
+{
+	return OrangutanEEPROMLog::getDroppedRecords();
+}
+
+extern "C" void eeprom_log_flush()
+{
+	OrangutanEEPROMLog::flush();
+}
+
+extern "C" unsigned int eeprom_log_read(unsigned int index, void *record)
+{
+	return OrangutanEEPROMLog::read(index, record);
+}
+
+#if _SERIAL_PORTS > 1
+extern "C" void eeprom_log_dump(unsigned char port)
+{
+	OrangutanEEPROMLog::dump(port);
+}
+#else
+extern "C" void eeprom_log_dump()
+{
+	OrangutanEEPROMLog::dump();
+}
+#endif
+
+ISR(EE_READY_vect)
+{
+	OrangutanEEPROMLog::writeNextByte();
+}
+
+static inline unsigned int nextSequenceNumber(unsigned int sequence)
+{
+	return sequence == EEPROM_LOG_ERASED - 1 ? 0 : sequence + 1;
+}
+
+// Reads one byte of EEPROM.  The caller must make sure no write is in
+// progress and that the EEPROM ready interrupt cannot start one.
+static inline unsigned char readByte(unsigned int address)
+{
+	EEAR = address;
+	EECR |= 1 << EERE;
+	return EEDR;
+}
+
+OrangutanEEPROMLog::OrangutanEEPROMLog()
+{
+}
+
+void OrangutanEEPROMLog::init(unsigned int start, unsigned int size, unsigned char recordSize,
+	unsigned char *buffer, unsigned char bufferRecords)
+{
+	flush();
+
+	OrangutanEEPROMLog::start = start;
+	OrangutanEEPROMLog::recordSize = recordSize;
+	OrangutanEEPROMLog::buffer = buffer;
+	OrangutanEEPROMLog::bufferRecords = bufferRecords;
+	slots = size / (recordSize + 2);
+	bufferHead = bufferTail = 0;
+	writeOffset = 0;
+	droppedRecords = 0;
+
+	// Find the newest record: sequence numbers increase by one from slot
+	// to slot until the slot after the newest one.
+	unsigned int sequence = readSequence(0);
+	if (sequence == EEPROM_LOG_ERASED)
+	{
+		nextSlot = 0;
+		nextSequence = 0;
+		count = 0;
+		return;
+	}
+
+	unsigned int slot = 0;
+	while (slot + 1 < slots)
+	{
+		unsigned int following = readSequence(slot + 1);
+		if (following != nextSequenceNumber(sequence))
+			break;
+		sequence = following;
+		slot++;
+	}
+
+	nextSequence = nextSequenceNumber(sequence);
+	nextSlot = (slot + 1 == slots) ? 0 : slot + 1;
+
+	// If the next slot has been written before, the log has wrapped around.
+	if (nextSlot == 0 || readSequence(nextSlot) != EEPROM_LOG_ERASED)
+		count = slots;
+	else
+		count = slot + 1;
+}
+
+// The whole append runs with interrupts disabled, so an interrupt that
+// also appends cannot claim the same staging record.
+unsigned char OrangutanEEPROMLog::append(const void *record)
+{
+	unsigned char sreg = SREG;
+	cli();
+
+	unsigned char head = bufferHead;
+	unsigned char next = head + 1;
+	if (next == bufferRecords)
+		next = 0;
+
+	if (next == bufferTail || slots == 0)
+	{
+		droppedRecords++;
+		SREG = sreg;
+		return 0;
+	}
+
+	memcpy(buffer + head * recordSize, record, recordSize);
+	bufferHead = next;
+	EECR |= 1 << EERIE;	// the EEPROM ready interrupt writes it out
+
+	SREG = sreg;
+	return 1;
+}
+
+inline void OrangutanEEPROMLog::writeNextByte()
+{
+	while (1)
+	{
+		if (bufferTail == bufferHead)
+		{
+			EECR &= ~(1 << EERIE);	// nothing left to write
+			return;
+		}
+
+		unsigned char value;
+		if (writeOffset < recordSize)
+			value = buffer[bufferTail * recordSize + writeOffset];
+		else if (writeOffset == recordSize)
+			value = nextSequence;
+		else
+			value = nextSequence >> 8;
+
+		unsigned int address = slotAddress(nextSlot) + writeOffset;
+
+		if (++writeOffset == recordSize + 2)
+		{
+			// The slot is complete (its sequence number is written last,
+			// so a slot cut short by a reset is never mistaken for the
+			// newest one).
+			writeOffset = 0;
+			if (++nextSlot == slots)
+				nextSlot = 0;
+			nextSequence = nextSequenceNumber(nextSequence);
+			if (count < slots)
+				count++;
+			unsigned char tail = bufferTail + 1;
+			bufferTail = (tail == bufferRecords) ? 0 : tail;
+		}
+
+		if (readByte(address) == value)
+			continue;	// skip the write to save time and wear
+
+		EEDR = value;
+		EECR |= 1 << EEMPE;
+		EECR |= 1 << EEPE;	// must follow within four clock cycles
+		return;
+	}
+}
+
+// Returns the number of complete records in EEPROM.  Once the log has
+// wrapped around, the slot being written holds the oldest record until
+// its first byte changes, so it is left out while a write to it is under
+// way.  Interrupts must be disabled.
+unsigned int OrangutanEEPROMLog::readableCount()
+{
+	if (count == slots && writeOffset != 0)
+		return count - 1;
+	return count;
+}
+
+unsigned int OrangutanEEPROMLog::getCount()
+{
+	unsigned char sreg = SREG;
+	cli();
+	unsigned int value = readableCount();
+	SREG = sreg;
+	return value;
+}
+
+void OrangutanEEPROMLog::flush()
+{
+	while (bufferTail != bufferHead)
+		OrangutanTime::idle();
+	while (EECR & (1 << EEPE))
+		;
+}
+
+unsigned int OrangutanEEPROMLog::readSequence(unsigned int slot)
+{
+	unsigned int address = slotAddress(slot) + recordSize;
+	return readByte(address) | (readByte(address + 1) << 8);
+}
+
+unsigned int OrangutanEEPROMLog::read(unsigned int index, void *record)
+{
+	// Wait for the write in progress, then read with interrupts disabled
+	// so that the EEPROM ready interrupt cannot start another one (or
+	// change EEAR) underneath us, even if an interrupt appends a record.
+	unsigned char sreg = SREG;
+	while (1)
+	{
+		cli();
+		if (!(EECR & (1 << EEPE)))
+			break;
+		SREG = sreg;
+	}
+
+	unsigned int sequence = EEPROM_LOG_ERASED;
+	unsigned int records = readableCount();
+	if (index < records)
+	{
+		unsigned int slot = nextSlot + slots - records + index;
+		if (slot >= slots)
+			slot -= slots;
+
+		unsigned int address = slotAddress(slot);
+		for (unsigned char i = 0; i < recordSize; i++)
+			((unsigned char *)record)[i] = readByte(address + i);
+		sequence = readSequence(slot);
+	}
+
+	SREG = sreg;
+	return sequence;
+}
+
+#if _SERIAL_PORTS > 1
+void OrangutanEEPROMLog::dump(unsigned char port)
+#else
+void OrangutanEEPROMLog::dump()
+#endif
+{
+	char data[EEPROM_LOG_MAX_RECORD_SIZE + 2];
+
+	if (recordSize > EEPROM_LOG_MAX_RECORD_SIZE)
+		return;
+
+	flush();
+
+	unsigned int records = getCount();
+	for (unsigned int i = 0; i < records; i++)
+	{
+		unsigned int sequence = read(i, data + 2);
+		data[0] = sequence;
+		data[1] = sequence >> 8;
+#if _SERIAL_PORTS > 1
+		OrangutanSerial::sendBlocking(port, data, recordSize + 2);
+#else
+		OrangutanSerial::sendBlocking(data, recordSize + 2);
+#endif
+	}
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,153 @@
+/*
+  OrangutanEEPROMLog.h - Ring log that stores fixed-size binary records in
+      the AVR's EEPROM, written in the background from a RAM staging buffer.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef OrangutanEEPROMLog_h
+#define OrangutanEEPROMLog_h
+
+#include "../OrangutanSerial/OrangutanSerial.h"
+
+// The largest record size supported by dump().
+#ifndef EEPROM_LOG_MAX_RECORD_SIZE
+#define EEPROM_LOG_MAX_RECORD_SIZE	32
+#endif
+
+#ifdef __cplusplus
+
+// The log uses an area of EEPROM as a ring of slots.  Each slot holds one
+// record followed by a 16-bit sequence number, which is written last.  When
+// the log starts, it scans the sequence numbers to find the newest record
+// and continues after it, so every slot is written equally often no matter
+// how many times the robot is restarted.  Unchanged bytes are not rewritten.
+//
+// Records are appended to a RAM staging buffer, and the EEPROM ready
+// interrupt writes them out one byte at a time (about 3.4 ms per byte)
+// while the program keeps running.  That interrupt changes EEAR and EEDR,
+// so do not use any of the avr-libc eeprom functions, including the
+// eeprom_read ones, while the log has records waiting to be written;
+// call flush() first.
+class OrangutanEEPROMLog
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	OrangutanEEPROMLog();
+
+	// Starts the log in EEPROM bytes start to start+size-1, with records
+	// of recordSize bytes.  The staging buffer must hold bufferRecords
+	// records (bufferRecords * recordSize bytes), and can hold up to
+	// bufferRecords-1 records waiting to be written.  The log must
+	// always be started with the same area and record size; otherwise
+	// the old contents are misread.
+	static void init(unsigned int start, unsigned int size, unsigned char recordSize,
+		unsigned char *buffer, unsigned char bufferRecords);
+
+	// Copies a record into the staging buffer.  Returns 1 on success, or
+	// 0 if the staging buffer is full, in which case the record is
+	// dropped and counted by getDroppedRecords().  Interrupts are
+	// disabled while the record is copied, so this can be called from
+	// an interrupt even when the main loop is also appending.
+	static unsigned char append(const void *record);
+
+	// Returns the number of records that read() can return, which stops
+	// increasing once every slot has been used.  After the log has
+	// wrapped around, it is one less while the oldest slot is being
+	// overwritten.
+	static unsigned int getCount();
+
+	// Returns the number of records that append() has dropped.
+	static inline unsigned int getDroppedRecords() { return droppedRecords; }
+
+	// Waits until every staged record has been written to EEPROM.
+	static void flush();
+
+	// Reads a record from EEPROM into record (recordSize bytes); index 0
+	// is the oldest record.  A slot that is partly overwritten by a
+	// staged record is skipped.  Returns the record's sequence number, or
+	// 0xFFFF if there is no such record.
+	static unsigned int read(unsigned int index, void *record);
+
+	// Flushes the log and sends every record, oldest first, over the
+	// serial port with OrangutanSerial::sendBlocking().  Each record is
+	// sent as its sequence number (two bytes, low byte first) followed
+	// by the record itself.  The serial port must already be set up.
+#if _SERIAL_PORTS > 1
+	static void dump(unsigned char port);
+#else
+	static void dump();
+#endif
+
+	// Don't call this function.  It is only public because the EEPROM
+	// ready interrupt in OrangutanEEPROMLog.cpp needs it.
+	static inline void writeNextByte();
+
+  private:
+
+	static unsigned int start;			// first EEPROM address of the log
+	static unsigned int slots;			// number of record slots in the log
+	static unsigned char recordSize;
+	static unsigned char *buffer;
+	static unsigned char bufferRecords;
+	static volatile unsigned char bufferHead;	// next staging record to fill
+	static volatile unsigned char bufferTail;	// staging record being written
+	static volatile unsigned char writeOffset;	// next byte of the slot being written
+	static volatile unsigned int nextSlot;		// slot being written
+	static volatile unsigned int nextSequence;	// sequence number of that slot
+	static volatile unsigned int count;
+	static unsigned int droppedRecords;
+
+	static unsigned int readSequence(unsigned int slot);
+	static unsigned int readableCount();
+	static inline unsigned int slotAddress(unsigned int slot) { return start + slot * (recordSize + 2); }
+};
+
+extern "C" {
+#endif // __cplusplus
+
+void eeprom_log_init(unsigned int start, unsigned int size, unsigned char record_size,
+	unsigned char *buffer, unsigned char buffer_records);
+unsigned char eeprom_log_append(const void *record);
+unsigned int eeprom_log_get_count(void);
+unsigned int eeprom_log_get_dropped_records(void);
+void eeprom_log_flush(void);
+unsigned int eeprom_log_read(unsigned int index, void *record);
+#if _SERIAL_PORTS > 1
+void eeprom_log_dump(unsigned char port);
+#else
+void eeprom_log_dump(void);
+#endif
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
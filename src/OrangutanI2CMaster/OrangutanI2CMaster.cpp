@@ -0,0 +1,252 @@
+/*
+  OrangutanI2CMaster.cpp - Library for communicating using the AVR's hardware
+      TWI (I2C) module in master mode, with a queue of interrupt-driven
+      transactions.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef F_CPU
+#define F_CPU 20000000UL
+#endif
+
+#include "OrangutanI2CMaster.h"
+#include "../OrangutanTime/OrangutanTime.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/twi.h>
+
+// TWCR values: every one clears TWINT to let the hardware continue.
+#define TWCR_NEXT	((1 << TWINT) | (1 << TWEN) | (1 << TWIE))
+#define TWCR_ACK	(TWCR_NEXT | (1 << TWEA))	// receive a byte and acknowledge it
+#define TWCR_NACK	TWCR_NEXT					// receive the last byte
+#define TWCR_START	(TWCR_NEXT | (1 << TWSTA))
+#define TWCR_STOP	(TWCR_NEXT | (1 << TWSTO))
+#define TWCR_RELEASE	((1 << TWINT) | (1 << TWEN) | (1 << TWIE))	// after losing arbitration
+
+I2CTransaction * volatile OrangutanI2CMaster::head = 0;
+I2CTransaction *OrangutanI2CMaster::tail = 0;
+unsigned char OrangutanI2CMaster::index;
+unsigned char OrangutanI2CMaster::reading;
+
+extern "C" void i2c_master_init(unsigned long frequency)
+{
+	OrangutanI2CMaster::init(frequency);
+}
+
+extern "C" void i2c_master_queue(I2CTransaction *transaction)
+{
+	OrangutanI2CMaster::queue(transaction);
+}
+
+extern "C" unsigned char i2c_master_transfer(I2CTransaction *transaction)
+{
+	return OrangutanI2CMaster::transfer(transaction);
+}
+
+extern "C" unsigned char i2c_master_is_busy()
+{
+	return OrangutanI2CMaster::isBusy();
+}
+
+extern "C" void i2c_master_prepare_read(I2CTransaction *transaction, unsigned char address,
+	unsigned char reg, unsigned char *buffer, unsigned char length)
+{
+	OrangutanI2CMaster::prepareRead(transaction, address, reg, buffer, length);
+}
+
+extern "C" void i2c_master_prepare_write(I2CTransaction *transaction, unsigned char address,
+	unsigned char *data, unsigned char length)
+{
+	OrangutanI2CMaster::prepareWrite(transaction, address, data, length);
+}
+
+ISR(TWI_vect)
+{
+	OrangutanI2CMaster::handleInterrupt();
+}
+
+void OrangutanI2CMaster::init(unsigned long frequency)
+{
+	// SCL frequency = F_CPU / (16 + 2 * TWBR) with a prescaler of 1
+	unsigned long twbr = (F_CPU / frequency - 16) / 2;
+	if (twbr > 255)
+		twbr = 255;
+
+	TWSR = 0;
+	TWBR = twbr;
+	TWCR = (1 << TWEN) | (1 << TWIE);
+}
+
+void OrangutanI2CMaster::prepareRead(I2CTransaction *transaction, unsigned char address,
+	unsigned char reg, unsigned char *buffer, unsigned char length)
+{
+	transaction->address = address;
+	transaction->reg = reg;
+	transaction->writeData = &transaction->reg;
+	transaction->writeLength = 1;
+	transaction->readData = buffer;
+	transaction->readLength = length;
+	transaction->callback = 0;
+}
+
+void OrangutanI2CMaster::prepareWrite(I2CTransaction *transaction, unsigned char address,
+	unsigned char *data, unsigned char length)
+{
+	transaction->address = address;
+	transaction->writeData = data;
+	transaction->writeLength = length;
+	transaction->readData = 0;
+	transaction->readLength = 0;
+	transaction->callback = 0;
+}
+
+void OrangutanI2CMaster::queue(I2CTransaction *transaction)
+{
+	transaction->status = I2C_QUEUED;
+	transaction->next = 0;
+
+	unsigned char sreg = SREG;
+	cli();
+	if (head == 0)
+	{
+		head = tail = transaction;
+		index = 0;
+		reading = 0;
+		TWCR = TWCR_START;
+	}
+	else
+	{
+		tail->next = transaction;
+		tail = transaction;
+	}
+	SREG = sreg;
+}
+
+unsigned char OrangutanI2CMaster::transfer(I2CTransaction *transaction)
+{
+	queue(transaction);
+	while (transaction->status == I2C_QUEUED)
+		OrangutanTime::idle();
+	return transaction->status;
+}
+
+// Ends the transaction in progress and starts the next one.  twcr tells
+// the hardware how to end this one (normally with a stop condition).
+void OrangutanI2CMaster::finish(unsigned char status, unsigned char twcr)
+{
+	I2CTransaction *done = head;
+
+	// The callback runs while this transaction is still at the head of
+	// the queue, so anything it queues is simply appended.
+	done->status = status;
+	if (done->callback)
+		done->callback(done);
+
+	head = done->next;
+	index = 0;
+	reading = 0;
+
+	// A start condition requested together with a stop is sent right
+	// after the stop.
+	if (head)
+		twcr |= 1 << TWSTA;
+	TWCR = twcr;
+}
+
+inline void OrangutanI2CMaster::handleInterrupt()
+{
+	I2CTransaction *t = head;
+	if (t == 0)
+	{
+		TWCR = TWCR_STOP & ~(1 << TWIE);
+		return;
+	}
+
+	switch (TW_STATUS)
+	{
+	case TW_START:
+	case TW_REP_START:
+		if (!reading && (t->writeLength || !t->readLength))
+			TWDR = (t->address << 1) | TW_WRITE;
+		else
+			TWDR = (t->address << 1) | TW_READ;
+		TWCR = TWCR_NEXT;
+		break;
+
+	case TW_MT_SLA_ACK:
+	case TW_MT_DATA_ACK:
+		if (index < t->writeLength)
+		{
+			TWDR = t->writeData[index++];
+			TWCR = TWCR_NEXT;
+		}
+		else if (t->readLength)
+		{
+			index = 0;
+			reading = 1;
+			TWCR = TWCR_START;	// repeated start, then read
+		}
+		else
+		{
+			finish(I2C_SUCCESS, TWCR_STOP);
+		}
+		break;
+
+	case TW_MR_SLA_ACK:
+		TWCR = (t->readLength > 1) ? TWCR_ACK : TWCR_NACK;
+		break;
+
+	case TW_MR_DATA_ACK:
+		t->readData[index++] = TWDR;
+		TWCR = (index + 1 < t->readLength) ? TWCR_ACK : TWCR_NACK;
+		break;
+
+	case TW_MR_DATA_NACK:
+		t->readData[index] = TWDR;
+		finish(I2C_SUCCESS, TWCR_STOP);
+		break;
+
+	case TW_MT_SLA_NACK:
+	case TW_MT_DATA_NACK:
+	case TW_MR_SLA_NACK:
+		finish(I2C_ERROR_NACK, TWCR_STOP);
+		break;
+
+	case TW_MT_ARB_LOST:
+		// We are no longer the master, so we can't send a stop.
+		finish(I2C_ERROR_ARBITRATION, TWCR_RELEASE);
+		break;
+
+	default:
+		finish(I2C_ERROR_BUS, TWCR_STOP);
+		break;
+	}
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,133 @@
+/*
+  OrangutanI2CMaster.h - Library for communicating using the AVR's hardware
+      TWI (I2C) module in master mode, with a queue of interrupt-driven
+      transactions.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef OrangutanI2CMaster_h
+#define OrangutanI2CMaster_h
+
+// Transaction status values.
+#define I2C_SUCCESS			0
+#define I2C_QUEUED			1	// waiting in the queue or in progress
+#define I2C_ERROR_NACK		2	// the slave did not acknowledge its address or a byte
+#define I2C_ERROR_ARBITRATION	3	// another master took over the bus
+#define I2C_ERROR_BUS		4	// illegal start or stop condition
+
+// One transfer with a slave: writeLength bytes are written from writeData,
+// then, after a repeated start, readLength bytes are read into readData.
+// Either length may be zero.  The structure and its buffers belong to the
+// caller and must stay valid until the status is no longer I2C_QUEUED.
+typedef struct I2CTransaction
+{
+	unsigned char address;		// 7-bit slave address
+	unsigned char writeLength;
+	unsigned char readLength;
+	unsigned char reg;			// register number, for i2c_master_prepare_read()
+	unsigned char *writeData;
+	unsigned char *readData;
+
+	// If not 0, called from the TWI interrupt when the transaction
+	// finishes.  It may queue another transaction.
+	void (*callback)(struct I2CTransaction *transaction);
+
+	volatile unsigned char status;
+	struct I2CTransaction *next;	// used by the queue
+} I2CTransaction;
+
+#ifdef __cplusplus
+
+// C++ Function Declarations
+
+class OrangutanI2CMaster
+{
+  public:
+
+	// Enables the TWI module as a master with the given SCL frequency in
+	// Hz (for example, 100000 or 400000).  The bus needs pull-up
+	// resistors on SDA and SCL.
+	static void init(unsigned long frequency);
+
+	// Adds a transaction to the end of the queue and returns right away.
+	// The TWI interrupt carries it out, sets its status and calls its
+	// callback.
+	static void queue(I2CTransaction *transaction);
+
+	// Queues a transaction and waits for it to finish (calling the
+	// OrangutanTime idle function while waiting).  Returns its status.
+	static unsigned char transfer(I2CTransaction *transaction);
+
+	// Returns 1 while there are transactions in the queue.
+	static inline unsigned char isBusy() { return head != 0; }
+
+	// Sets up a transaction that reads length bytes starting at register
+	// reg of a device that auto-increments its register address.
+	static void prepareRead(I2CTransaction *transaction, unsigned char address,
+		unsigned char reg, unsigned char *buffer, unsigned char length);
+
+	// Sets up a transaction that writes length bytes from data, which
+	// normally starts with the register number.
+	static void prepareWrite(I2CTransaction *transaction, unsigned char address,
+		unsigned char *data, unsigned char length);
+
+	// Don't call this function.  It is only public because the TWI
+	// interrupt in OrangutanI2CMaster.cpp needs it.
+	static inline void handleInterrupt();
+
+  private:
+
+	static I2CTransaction * volatile head;	// transaction in progress
+	static I2CTransaction *tail;
+	static unsigned char index;		// next byte to write or read
+	static unsigned char reading;	// 1 after the repeated start
+
+	static void finish(unsigned char status, unsigned char twcr);
+};
+
+extern "C" {
+#endif // __cplusplus
+
+// C Function Declarations
+
+void i2c_master_init(unsigned long frequency);
+void i2c_master_queue(I2CTransaction *transaction);
+unsigned char i2c_master_transfer(I2CTransaction *transaction);
+unsigned char i2c_master_is_busy(void);
+void i2c_master_prepare_read(I2CTransaction *transaction, unsigned char address,
+	unsigned char reg, unsigned char *buffer, unsigned char length);
+void i2c_master_prepare_write(I2CTransaction *transaction, unsigned char address,
+	unsigned char *data, unsigned char length);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -23,15 +23,277 @@
  */
  
 #include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
 #include "OrangutanLEDs.h"
 
-
 // constructor
 OrangutanLEDs::OrangutanLEDs()
 {
 
 }
 
+// The LED engine runs from the OrangutanTime millisecond callback, which
+// Arduino does not have.
+#ifndef ARDUINO
+
+#include "../OrangutanTime/OrangutanTime.h"
+
+#define LED_STEADY	0
+#define LED_PATTERN	1
+#define LED_CODE	2
+#define LED_UNUSED	3	// the pin has not been touched yet
+
+const unsigned char led_pattern_heartbeat[] PROGMEM = { 255, 8, 0, 12, 255, 8, 0, 72, 0, LED_END };
+const unsigned char led_pattern_breathe[] PROGMEM = { 255, LED_FADE + 100, 0, LED_FADE + 100, 0, LED_END };
+const unsigned char led_pattern_blink_slow[] PROGMEM = { 255, 50, 0, 50, 0, LED_END };
+const unsigned char led_pattern_blink_fast[] PROGMEM = { 255, 10, 0, 10, 0, LED_END };
+
+struct LEDChannel
+{
+	unsigned char pin;
+	volatile unsigned char *port;
+	unsigned char mask;
+	unsigned char activeLow;
+	unsigned char mode;			// LED_STEADY, LED_PATTERN, LED_CODE or LED_UNUSED
+	unsigned char pwm;			// delta-sigma accumulator
+	unsigned int level;			// brightness * 256
+	int fadeStep;				// added to level every millisecond
+	unsigned char target;		// brightness at the end of the step
+	unsigned char step;			// index of the next pattern or blink code step
+	unsigned int remaining;		// milliseconds left in the current step
+	const unsigned char *pattern;
+	unsigned char codeCount;
+};
+
+static LEDChannel channels[LED_MAX_CHANNELS];
+static unsigned char channelCount;
+
+extern "C" unsigned char led_engine_init()
+{
+	return OrangutanLEDs::initEngine();
+}
+
+extern "C" unsigned char led_add(unsigned char pin, unsigned char active_low)
+{
+	return OrangutanLEDs::addLED(pin, active_low);
+}
+
+extern "C" void led_set_brightness(unsigned char channel, unsigned char brightness)
+{
+	OrangutanLEDs::setBrightness(channel, brightness);
+}
+
+extern "C" void led_play_pattern(unsigned char channel, const unsigned char *pattern)
+{
+	OrangutanLEDs::playPattern(channel, pattern);
+}
+
+extern "C" void led_blink_code(unsigned char channel, unsigned char count)
+{
+	OrangutanLEDs::blinkCode(channel, count);
+}
+
+unsigned char OrangutanLEDs::initEngine()
+{
+	OrangutanTime::removeMillisecondCallback(updateEngine);
+	channelCount = 0;
+
+#ifdef _ORANGUTAN_SVP
+	addLED(RED_LED, 1);		// red LED turns on when driven low
+#else
+	addLED(RED_LED, 0);
+#endif
+	addLED(GREEN_LED, 0);
+#ifdef _ORANGUTAN_X2
+	addLED(RED_LED2, 0);
+	addLED(GREEN_LED2, 0);
+	addLED(YELLOW_LED, 0);
+#endif
+
+	return OrangutanTime::addMillisecondCallback(updateEngine);
+}
+
+unsigned char OrangutanLEDs::addLED(unsigned char pin, unsigned char active_low)
+{
+	if (channelCount >= LED_MAX_CHANNELS)
+		return 255;
+
+	struct IOStruct io;
+	OrangutanDigital::getIORegisters(&io, pin);
+
+	// The pin is left alone until the channel is first given something
+	// to show (see useChannel()), so a built-in LED that shares a pin
+	// with the LCD is not disturbed just by starting the engine.
+	LEDChannel *c = &channels[channelCount];
+	c->pin = pin;
+	c->port = io.portRegister;
+	c->mask = io.bitmask;
+	c->activeLow = active_low ? 1 : 0;
+	c->mode = LED_UNUSED;
+	c->level = 0;
+	c->target = 0;
+	c->fadeStep = 0;
+
+	// the interrupt only looks at the new channel once the count includes it
+	return channelCount++;
+}
+
+// Makes the channel's pin an output the first time the channel is used.
+// Call with interrupts disabled.
+inline void OrangutanLEDs::useChannel(unsigned char channel)
+{
+	LEDChannel *c = &channels[channel];
+	if (c->mode == LED_UNUSED)
+	{
+		OrangutanDigital::setOutput(c->pin, c->activeLow ? HIGH : LOW);	// off
+		c->mode = LED_STEADY;
+	}
+}
+
+void OrangutanLEDs::setBrightness(unsigned char channel, unsigned char brightness)
+{
+	LEDChannel *c = &channels[channel];
+	unsigned char sreg = SREG;
+	cli();
+	useChannel(channel);
+	c->mode = LED_STEADY;
+	c->level = brightness << 8;
+	c->target = brightness;
+	c->fadeStep = 0;
+	SREG = sreg;
+}
+
+void OrangutanLEDs::playPattern(unsigned char channel, const unsigned char *pattern)
+{
+	LEDChannel *c = &channels[channel];
+	unsigned char sreg = SREG;
+	cli();
+	useChannel(channel);
+	c->mode = LED_PATTERN;
+	c->pattern = pattern;
+	c->step = 0;
+	c->target = c->level >> 8;	// fade from the current brightness
+	startStep(channel);
+	SREG = sreg;
+}
+
+void OrangutanLEDs::blinkCode(unsigned char channel, unsigned char count)
+{
+	if (count == 0)
+	{
+		setBrightness(channel, 0);
+		return;
+	}
+
+	LEDChannel *c = &channels[channel];
+	unsigned char sreg = SREG;
+	cli();
+	useChannel(channel);
+	c->mode = LED_CODE;
+	c->codeCount = count;
+	c->step = 0;
+	c->target = c->level >> 8;
+	startStep(channel);
+	SREG = sreg;
+}
+
+// Sets up the next step of a channel's pattern or blink code.
+inline void OrangutanLEDs::startStep(unsigned char channel)
+{
+	LEDChannel *c = &channels[channel];
+	unsigned char brightness, duration;
+
+	c->level = c->target << 8;	// finish any fade exactly
+	c->fadeStep = 0;
+
+	if (c->mode == LED_CODE)
+	{
+		// Steps 0, 2, 4... are on and 1, 3, 5... are off; the last off
+		// step is the pause between codes.
+		unsigned char last = 2*c->codeCount - 1;
+		brightness = (c->step & 1) ? 0 : 255;
+		duration = 20;
+		if (c->step == last)
+			duration = 100;
+		c->step = c->step == last ? 0 : c->step + 1;
+	}
+	else
+	{
+		const unsigned char *p = c->pattern + 2*c->step;
+		duration = pgm_read_byte(p + 1);
+		if (duration == LED_END)
+		{
+			if (c->step == 0)
+			{
+				// empty pattern
+				c->mode = LED_STEADY;
+				c->target = 0;
+				c->level = 0;
+				return;
+			}
+			c->step = 0;
+			p = c->pattern;
+			duration = pgm_read_byte(p + 1);
+		}
+		brightness = pgm_read_byte(p);
+		c->step++;
+	}
+
+	unsigned int ms = (duration & ~LED_FADE) * 10;
+	if (ms == 0)
+		ms = 1;
+	if (duration & LED_FADE)
+		c->fadeStep = (((long)brightness << 8) - (long)c->level) / (long)ms;
+	else
+		c->level = brightness << 8;
+	c->target = brightness;
+	c->remaining = ms;
+}
+
+void OrangutanLEDs::updateEngine()
+{
+	for (unsigned char i = 0; i < channelCount; i++)
+	{
+		LEDChannel *c = &channels[i];
+
+		if (c->mode == LED_UNUSED)
+			continue;	// never touch a pin the program has not asked for
+
+		if (c->mode != LED_STEADY && --c->remaining == 0)
+			startStep(i);
+		else
+			c->level += c->fadeStep;
+
+		// First-order delta-sigma modulation: the LED is on whenever
+		// adding the brightness to the accumulator overflows it, which
+		// spreads the on-time evenly instead of in one long pulse.
+		unsigned char brightness = c->level >> 8;
+		unsigned char on;
+		if (brightness == 255)
+			on = 1;
+		else
+		{
+			unsigned int sum = c->pwm + brightness;
+			c->pwm = sum;
+			on = sum >> 8;
+		}
+
+		// This callback runs with interrupts enabled, so keep a higher
+		// priority interrupt from changing the port in the middle of the
+		// read-modify-write.
+		unsigned char sreg = SREG;
+		cli();
+		if (on ^ c->activeLow)
+			*c->port |= c->mask;
+		else
+			*c->port &= ~c->mask;
+		SREG = sreg;
+	}
+}
+
+#endif // ARDUINO
+
 // Local Variables: **
 // mode: C++ **
 // c-basic-offset: 4 **
@@ -43,6 +43,34 @@
 #define GREEN_LED		IO_D7
 #endif
 
+// Channel numbers of the built-in LEDs in the LED engine.  Channels added
+// with addLED() are numbered after these.
+#define LED_CHANNEL_RED		0
+#define LED_CHANNEL_GREEN	1
+#ifdef _ORANGUTAN_X2
+#define LED_CHANNEL_RED2	2
+#define LED_CHANNEL_GREEN2	3
+#define LED_CHANNEL_YELLOW	4
+#define LED_BUILT_IN_CHANNELS	5
+#else
+#define LED_BUILT_IN_CHANNELS	2
+#endif
+
+// The number of channels (built-in plus added LEDs) the engine can drive.
+#ifndef LED_MAX_CHANNELS
+#define LED_MAX_CHANNELS	(LED_BUILT_IN_CHANNELS + 2)
+#endif
+
+// Patterns are arrays of byte pairs in program space: a brightness
+// (0-255) and a duration in units of 10 ms (1-127).  If LED_FADE is added
+// to the duration, the brightness ramps from its old value to the new one
+// over the step instead of jumping.  A duration of LED_END ends the
+// pattern, which then starts over.  For example, a slow blink:
+//
+//   const unsigned char slow_blink[] PROGMEM = { 255, 50, 0, 50, 0, LED_END };
+#define LED_FADE	0x80
+#define LED_END		0
+
 #ifdef __cplusplus
 
 class OrangutanLEDs
@@ -111,6 +139,54 @@ class OrangutanLEDs
 		OrangutanDigital::setOutput(YELLOW_LED, on);
 	}
 #endif // _ORANGUTAN_X2
+
+#ifndef ARDUINO	// the engine needs the OrangutanTime millisecond callback
+	// LED ENGINE
+	//
+	// The LED engine runs from the OrangutanTime millisecond callback, so
+	// once it is set up the LEDs show status without any help from the
+	// main loop.  Each channel is an LED on any I/O pin, with a
+	// brightness produced by software PWM (first-order delta-sigma at
+	// 1 kHz, so low brightness levels flicker a little) or a pattern.
+	//
+	// The engine does not touch a channel's pin until the channel is
+	// first given a brightness, pattern or blink code.  On the 3pi and
+	// the Orangutan SV, LV and Baby Orangutan, the green LED shares PD7
+	// with the LCD data lines, and the LCD routines restore PORTD after
+	// each transfer, so do not use the green channel while also using
+	// the LCD on those boards.
+
+	// Starts the engine with the built-in LEDs as channels 0 and up (see
+	// LED_CHANNEL_*), unused until set.  Returns 0 if no millisecond
+	// callback slot was free.
+	static unsigned char initEngine();
+
+	// Adds an LED on the given pin as a new channel and returns its
+	// number, or 255 if all LED_MAX_CHANNELS channels are in use.  Use a
+	// nonzero active_low if the LED turns on when the pin is driven low.
+	static unsigned char addLED(unsigned char pin, unsigned char active_low);
+
+	// Sets a channel to a steady brightness from 0 (off) to 255 (on),
+	// stopping its pattern.
+	static void setBrightness(unsigned char channel, unsigned char brightness);
+
+	// Plays a pattern (see LED_FADE above) from program space on a
+	// channel, over and over, until another pattern, blink code or
+	// brightness is set.
+	static void playPattern(unsigned char channel, const unsigned char *pattern);
+
+	// Repeatedly blinks a channel count times (200 ms on, 200 ms off)
+	// followed by a one-second pause.  A count of 0 turns the LED off.
+	static void blinkCode(unsigned char channel, unsigned char count);
+
+	// Don't call this function.  It is only public because it is
+	// registered as a millisecond callback.
+	static void updateEngine();
+
+  private:
+	static inline void useChannel(unsigned char channel);
+	static inline void startStep(unsigned char channel);
+#endif // ARDUINO
 };
 
 extern "C" {
@@ -176,6 +252,19 @@ static inline void yellow_led(unsigned char on)
 }
 #endif //_ORANGUTAN_X2
 
+#ifndef ARDUINO
+// Patterns that come with the library, for playPattern().
+extern const unsigned char led_pattern_heartbeat[];		// two short pulses per second
+extern const unsigned char led_pattern_breathe[];		// slow fade in and out
+extern const unsigned char led_pattern_blink_slow[];	// 1 Hz
+extern const unsigned char led_pattern_blink_fast[];	// 5 Hz
+
+unsigned char led_engine_init(void);
+unsigned char led_add(unsigned char pin, unsigned char active_low);
+void led_set_brightness(unsigned char channel, unsigned char brightness);
+void led_play_pattern(unsigned char channel, const unsigned char *pattern);
+void led_blink_code(unsigned char channel, unsigned char count);
+#endif // ARDUINO
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,180 @@
+/*
+  OrangutanProfiler.cpp - Named-section profiling counters on the
+      OrangutanTime tick, compiled in only when POLOLU_PROFILE is defined.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#include "OrangutanProfiler.h"
+#include "../OrangutanTime/OrangutanTime.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+// Stored in the id of a section that did not fit in the table.
+#define PROFILE_NO_ENTRY	0xFF
+
+unsigned char OrangutanProfiler::sectionCount = 0;
+ProfileSection OrangutanProfiler::sections[PROFILE_MAX_SECTIONS];
+
+extern "C" void profile_record(unsigned char *id, const char *name, unsigned long elapsed)
+{
+	OrangutanProfiler::record(id, name, elapsed);
+}
+
+extern "C" unsigned char profile_get_section_count()
+{
+	return OrangutanProfiler::getSectionCount();
+}
+
+extern "C" unsigned char profile_get_section(unsigned char index, ProfileSection *section)
+{
+	return OrangutanProfiler::getSection(index, section);
+}
+
+extern "C" void profile_reset()
+{
+	OrangutanProfiler::reset();
+}
+
+extern "C" void profile_print(FILE *stream)
+{
+	OrangutanProfiler::print(stream);
+}
+
+extern "C" void profile_print_section(FILE *stream, unsigned char index)
+{
+	OrangutanProfiler::printSection(stream, index);
+}
+
+
+// *id holds the table index plus one, so that the zero-initialized
+// static in each PROFILE_ macro means "not assigned yet".
+void OrangutanProfiler::record(unsigned char *id, const char *name, unsigned long elapsed)
+{
+	unsigned char sreg = SREG;
+	cli();
+
+	if (*id == 0)
+	{
+		if (sectionCount == PROFILE_MAX_SECTIONS)
+		{
+			*id = PROFILE_NO_ENTRY;
+			SREG = sreg;
+			return;
+		}
+		ProfileSection *s = &sections[sectionCount];
+		s->name = name;
+		s->count = 0;
+		s->total = 0;
+		s->min = 0xFFFFFFFF;
+		s->max = 0;
+		*id = ++sectionCount;
+	}
+	else if (*id == PROFILE_NO_ENTRY)
+	{
+		SREG = sreg;
+		return;
+	}
+
+	ProfileSection *s = &sections[*id - 1];
+	s->count++;
+	s->total += elapsed;
+	if (elapsed < s->min)
+		s->min = elapsed;
+	if (elapsed > s->max)
+		s->max = elapsed;
+
+	SREG = sreg;
+}
+
+unsigned char OrangutanProfiler::getSection(unsigned char index, ProfileSection *section)
+{
+	if (index >= sectionCount)
+		return 0;
+
+	unsigned char sreg = SREG;
+	cli();
+	*section = sections[index];
+	SREG = sreg;
+	return 1;
+}
+
+void OrangutanProfiler::reset()
+{
+	unsigned char sreg = SREG;
+	cli();
+	for (unsigned char i = 0; i < sectionCount; i++)
+	{
+		sections[i].count = 0;
+		sections[i].total = 0;
+		sections[i].min = 0xFFFFFFFF;
+		sections[i].max = 0;
+	}
+	SREG = sreg;
+}
+
+// Fills in the average and converts the times to microseconds.  A
+// section that has not run since reset() reads as all zeros.
+static void toMicroseconds(ProfileSection *s, unsigned long *avg)
+{
+	if (s->count == 0)
+	{
+		s->min = 0;
+		*avg = 0;
+		return;
+	}
+	*avg = OrangutanTime::ticksToMicroseconds(s->total / s->count);
+	s->min = OrangutanTime::ticksToMicroseconds(s->min);
+	s->max = OrangutanTime::ticksToMicroseconds(s->max);
+}
+
+void OrangutanProfiler::print(FILE *stream)
+{
+	ProfileSection s;
+	unsigned long avg;
+
+	for (unsigned char i = 0; getSection(i, &s); i++)
+	{
+		toMicroseconds(&s, &avg);
+		fprintf_P(stream, PSTR("%S %lu %lu %lu %lu\n"),
+				  s.name, s.count, s.min, avg, s.max);
+	}
+}
+
+void OrangutanProfiler::printSection(FILE *stream, unsigned char index)
+{
+	ProfileSection s;
+	unsigned long avg;
+
+	if (!getSection(index, &s))
+		return;
+	toMicroseconds(&s, &avg);
+	fprintf_P(stream, PSTR("%.8S\n%lu %lu"), s.name, avg, s.max);
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
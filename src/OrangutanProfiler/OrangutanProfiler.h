@@ -0,0 +1,171 @@
+/*
+  OrangutanProfiler.h - Named-section profiling counters on the
+      OrangutanTime tick, compiled in only when POLOLU_PROFILE is defined.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#ifndef OrangutanProfiler_h
+#define OrangutanProfiler_h
+
+#include <stdio.h>
+#include <avr/pgmspace.h>
+#ifdef POLOLU_PROFILE
+#include "../OrangutanTime/OrangutanTime.h"
+#endif
+
+// Sections are numbered 0 to PROFILE_MAX_SECTIONS-1 in the order they
+// first finish.  Sections past the end of the table are not recorded.
+#define PROFILE_MAX_SECTIONS	12
+
+// Profiling macros.  Wrap the code to measure in
+//   PROFILE_BEGIN(name);
+//   ...
+//   PROFILE_END(name);
+// or, in C++, put PROFILE_SCOPE(name); at the top of a block to measure
+// until the block is left (including early returns).  name must be a
+// valid identifier; it is also the name the section is reported under.
+// Each PROFILE_END() or PROFILE_SCOPE() gets its own table entry.
+//
+// The macros expand to nothing unless POLOLU_PROFILE is defined, so they
+// cost nothing in normal builds.  The library's own sections
+// (qtr_read_rc, qtr_read_analog, serial_send, buzzer_next_note and
+// svp_update_variables) are only present in the profiling build of the
+// library, libpololu_<device>_profile.a ("make profile").
+//
+// Time spent in interrupts that fire during a section is counted as
+// part of the section.
+#ifdef POLOLU_PROFILE
+
+#define PROFILE_BEGIN(name) \
+	unsigned long profile_start_##name = get_ticks()
+#define PROFILE_END(name) \
+	do { \
+		static unsigned char profile_id; \
+		profile_record(&profile_id, PSTR(#name), get_ticks() - profile_start_##name); \
+	} while(0)
+#define PROFILE_SCOPE(name) \
+	static unsigned char profile_id_##name; \
+	OrangutanProfileScope profile_scope_##name(&profile_id_##name, PSTR(#name))
+
+#else
+
+#define PROFILE_BEGIN(name)		do {} while(0)
+#define PROFILE_END(name)		do {} while(0)
+#define PROFILE_SCOPE(name)		do {} while(0)
+
+#endif
+
+// Statistics for one section.  Times are in ticks (0.4 us); total
+// wraps after about 28 minutes spent in the section.
+typedef struct ProfileSection
+{
+	const char *name;		// in program space
+	unsigned long count;
+	unsigned long total;
+	unsigned long min;
+	unsigned long max;
+} ProfileSection;
+
+#ifdef __cplusplus
+
+class OrangutanProfiler
+{
+  public:
+
+	// Adds one run of elapsed ticks to the section whose table index is
+	// stored in *id, assigning it an entry on its first run (*id starts
+	// at 0).  Used by the PROFILE_ macros; safe to call from interrupts.
+	static void record(unsigned char *id, const char *name, unsigned long elapsed);
+
+	// Returns the number of sections in the table.
+	static inline unsigned char getSectionCount() { return sectionCount; }
+
+	// Copies the statistics of the given section.  Returns 0 if there
+	// is no such section.
+	static unsigned char getSection(unsigned char index, ProfileSection *section);
+
+	// Clears the statistics of every section (their entries are kept).
+	static void reset();
+
+	// Prints one line per section to the given stream, e.g. the one
+	// returned by OrangutanSerial::initPrintf(), or stdout after
+	// lcd_init_printf():
+	//   name count min avg max
+	// with the times in microseconds.
+	static void print(FILE *stream);
+
+	// Prints one section as its name and then "avg max" in
+	// microseconds on the next line, which fits an 8x2 LCD.
+	static void printSection(FILE *stream, unsigned char index);
+
+  private:
+
+	static unsigned char sectionCount;
+	static ProfileSection sections[PROFILE_MAX_SECTIONS];
+};
+
+#ifdef POLOLU_PROFILE
+
+// Measures from its construction until it goes out of scope.  Use it
+// through PROFILE_SCOPE().
+class OrangutanProfileScope
+{
+  public:
+
+	inline OrangutanProfileScope(unsigned char *id, const char *name)
+		: id(id), name(name), start(OrangutanTime::ticks()) { }
+	inline ~OrangutanProfileScope()
+	{
+		OrangutanProfiler::record(id, name, OrangutanTime::ticks() - start);
+	}
+
+  private:
+
+	unsigned char *id;
+	const char *name;
+	unsigned long start;
+};
+
+#endif // POLOLU_PROFILE
+
+extern "C" {
+#endif // __cplusplus
+
+void profile_record(unsigned char *id, const char *name, unsigned long elapsed);
+unsigned char profile_get_section_count(void);
+unsigned char profile_get_section(unsigned char index, ProfileSection *section);
+void profile_reset(void);
+void profile_print(FILE *stream);
+void profile_print_section(FILE *stream, unsigned char index);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -25,6 +25,7 @@
 #include "../OrangutanResources/include/OrangutanModel.h"
 #include "../OrangutanSPIMaster/OrangutanSPIMaster.h"
 #include "../OrangutanTime/OrangutanTime.h"
+#include "../OrangutanProfiler/OrangutanProfiler.h"
 #include "OrangutanSVP.h"
 
 #ifdef _ORANGUTAN_SVP
@@ -89,6 +90,11 @@ typedef union SVPVariables
     	unsigned int trimpot;
     	unsigned int battery;
 	};
+	struct
+	{
+		unsigned char statusByte;
+		unsigned int analog[6];	// indexed by SVP_AUX_*
+	};
 } SVPVariables;
 
 typedef union SVPEncoders
@@ -123,6 +129,13 @@ static SVPVariables svp_variables;
 
 static SVPEncoders encoders;
 
+/* Background averaging of the analog values. */
+static unsigned char averaging_samples;		// 0 means off
+static unsigned char averaging_count;		// snapshots in the sums
+static unsigned long averaging_sums[6];
+static unsigned int averages[6];
+static unsigned char averages_valid;
+
 /* LOW-LEVEL FUNCTIONS FOR DOING SPI COMMUNICATION ****************************/
 // All the delays in these functions were chosen by doing an analysis of the
 // auxiliary processor's assembly code for handling SPI communication.
@@ -140,12 +153,33 @@ unsigned char OrangutanSVP::getNextByte()
 
 static void updateVariables()
 {
+	PROFILE_SCOPE(svp_update_variables);
+
     OrangutanSPIMaster::transmitAndDelay(0x81, 7);
 
 	for(unsigned char i=0; i < sizeof(SVPVariables); i++)
 	{
 		svp_variables.byte[i] = OrangutanSVP::getNextByte();
 	}
+
+	if (averaging_samples)
+	{
+		for(unsigned char i=0; i < 6; i++)
+		{
+			averaging_sums[i] += svp_variables.analog[i];
+		}
+
+		if (++averaging_count == averaging_samples)
+		{
+			for(unsigned char i=0; i < 6; i++)
+			{
+				averages[i] = (averaging_sums[i] + (averaging_samples >> 1)) / averaging_samples;
+				averaging_sums[i] = 0;
+			}
+			averaging_count = 0;
+			averages_valid = 1;
+		}
+	}
 }
 
 SVPEncoders updateEncoders()
@@ -260,6 +294,37 @@ unsigned int OrangutanSVP::getChannelDMillivolts()
 	return svp_variables.channelD;
 }
 
+unsigned int OrangutanSVP::getAuxMillivolts(unsigned char index)
+{
+	updateVariablesIfNeeded();
+	return svp_variables.analog[index];
+}
+
+void OrangutanSVP::updateAnalog()
+{
+	updateVariablesIfNeeded();
+}
+
+void OrangutanSVP::setAveraging(unsigned char samples)
+{
+	averaging_samples = samples > 1 ? samples : 0;
+	averaging_count = 0;
+	averages_valid = 0;
+	for(unsigned char i=0; i < 6; i++)
+	{
+		averaging_sums[i] = 0;
+	}
+}
+
+unsigned int OrangutanSVP::getAverageMillivolts(unsigned char index)
+{
+	if (!averages_valid)
+	{
+		return getAuxMillivolts(index);
+	}
+	return averages[index];
+}
+
 SVPStatus OrangutanSVP::getStatus()
 {
 	updateVariablesIfNeeded();
@@ -35,6 +35,15 @@
 
 #define SVP_SLAVE_SELECT_ON   1
 
+// Indices of the analog values that the auxiliary processor measures, for
+// getAuxMillivolts() and getAverageMillivolts().
+#define SVP_AUX_CHANNEL_A     0
+#define SVP_AUX_CHANNEL_B     1
+#define SVP_AUX_CHANNEL_C     2
+#define SVP_AUX_CHANNEL_D     3
+#define SVP_AUX_TRIMPOT       4
+#define SVP_AUX_BATTERY       5
+
 typedef	union SVPStatus
 {
 	unsigned char status;
@@ -86,6 +95,27 @@ class OrangutanSVP
 	static unsigned int getChannelCMillivolts();
 	static unsigned int getChannelDMillivolts();
 	static SVPStatus getStatus();
+
+	// Returns one of the analog values above (SVP_AUX_*) from the cached
+	// copy of the auxiliary processor's variables.  Like the functions
+	// above, this reads all the variables over SPI at most once per
+	// millisecond.
+	static unsigned int getAuxMillivolts(unsigned char index);
+
+	// Makes sure the cached variables are from the current millisecond.
+	// Call this regularly (for example from an OrangutanScheduler task)
+	// to keep background averaging going when nothing else reads them.
+	static void updateAnalog();
+
+	// Background averaging: every time the cached variables are read from
+	// the auxiliary processor, the analog values are added to running
+	// sums, and every 'samples' snapshots the averages are updated.  No
+	// extra SPI traffic is generated.  0 or 1 turns averaging off.
+	static void setAveraging(unsigned char samples);
+
+	// Returns the latest background average of an analog value (SVP_AUX_*),
+	// or the cached value if averaging is off or no average is done yet.
+	static unsigned int getAverageMillivolts(unsigned char index);
 };
 
 extern "C" {
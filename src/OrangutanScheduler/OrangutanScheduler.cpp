@@ -0,0 +1,154 @@
+/*
+  OrangutanScheduler.cpp - Small cooperative scheduler for periodic service
+      routines such as serial_check(), play_check() and application polls.
+*/
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#include "OrangutanScheduler.h"
+#include "../OrangutanTime/OrangutanTime.h"
+
+#include <avr/io.h>
+#include <avr/sleep.h>
+
+SchedulerTask OrangutanScheduler::tasks[SCHEDULER_MAX_TASKS];
+unsigned char OrangutanScheduler::taskCount = 0;
+unsigned char OrangutanScheduler::running = 0;
+unsigned char OrangutanScheduler::sleepWhenIdle = 1;
+
+extern "C" unsigned char scheduler_add_task(void (*function)(void), unsigned int period_ms, unsigned char priority)
+{
+	return OrangutanScheduler::addTask(function, period_ms, priority);
+}
+
+extern "C" void scheduler_remove_task(void (*function)(void))
+{
+	OrangutanScheduler::removeTask(function);
+}
+
+extern "C" unsigned char scheduler_run()
+{
+	return OrangutanScheduler::run();
+}
+
+extern "C" void scheduler_idle()
+{
+	OrangutanScheduler::idle();
+}
+
+extern "C" void scheduler_set_sleep_when_idle(unsigned char enable)
+{
+	OrangutanScheduler::setSleepWhenIdle(enable);
+}
+
+OrangutanScheduler::OrangutanScheduler()
+{
+}
+
+unsigned char OrangutanScheduler::addTask(void (*function)(void), unsigned int period_ms, unsigned char priority)
+{
+	removeTask(function);
+
+	if (taskCount >= SCHEDULER_MAX_TASKS)
+		return 0;
+
+	// insertion sort: keep the table ordered by priority, with tasks of
+	// equal priority running in the order they were added
+	unsigned char i = taskCount;
+	while (i > 0 && tasks[i-1].priority > priority)
+	{
+		tasks[i] = tasks[i-1];
+		i--;
+	}
+
+	tasks[i].function = function;
+	tasks[i].period_ms = period_ms;
+	tasks[i].last_run_ms = (unsigned int)OrangutanTime::ms();
+	tasks[i].priority = priority;
+	taskCount++;
+
+	OrangutanTime::setIdleFunction(idle);
+	return 1;
+}
+
+void OrangutanScheduler::removeTask(void (*function)(void))
+{
+	for (unsigned char i = 0; i < taskCount; i++)
+	{
+		if (tasks[i].function != function)
+			continue;
+
+		taskCount--;
+		for (; i < taskCount; i++)
+			tasks[i] = tasks[i+1];
+		break;
+	}
+
+	// leave an idle function that someone else installed alone
+	if (taskCount == 0 && OrangutanTime::getIdleFunction() == idle)
+		OrangutanTime::setIdleFunction(0);
+}
+
+unsigned char OrangutanScheduler::run()
+{
+	if (running)
+		return 0;
+	running = 1;
+
+	unsigned char ran = 0;
+	unsigned int now = (unsigned int)OrangutanTime::ms();
+
+	for (unsigned char i = 0; i < taskCount; i++)
+	{
+		SchedulerTask *task = &tasks[i];
+
+		// unsigned subtraction handles the 16-bit wrap-around
+		if ((unsigned int)(now - task->last_run_ms) < task->period_ms)
+			continue;
+
+		// advance by whole periods so a task keeps its rate even if it
+		// runs a little late, but don't try to catch up on missed runs
+		task->last_run_ms += task->period_ms;
+		if ((unsigned int)(now - task->last_run_ms) >= task->period_ms)
+			task->last_run_ms = now;
+
+		task->function();
+		ran++;
+	}
+
+	running = 0;
+	return ran;
+}
+
+void OrangutanScheduler::idle()
+{
+	if (run() == 0 && sleepWhenIdle && !running && !OrangutanTime::isPolling())
+	{
+		set_sleep_mode(SLEEP_MODE_IDLE);
+		sleep_mode();
+	}
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,117 @@
+/*
+  OrangutanScheduler.h - Small cooperative scheduler for periodic service
+      routines such as serial_check(), play_check() and application polls.
+*/
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#ifndef OrangutanScheduler_h
+#define OrangutanScheduler_h
+
+// The maximum number of tasks that can be registered at once.  Each task
+// uses 7 bytes of RAM.
+#ifndef SCHEDULER_MAX_TASKS
+#define SCHEDULER_MAX_TASKS 8
+#endif
+
+#ifdef __cplusplus
+
+typedef struct SchedulerTask
+{
+	void (*function)(void);
+	unsigned int period_ms;
+	unsigned int last_run_ms;	// low 16 bits of get_ms() when the task last ran
+	unsigned char priority;
+} SchedulerTask;
+
+class OrangutanScheduler
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	OrangutanScheduler();
+
+	// Registers a function to be called every period_ms milliseconds
+	// (0 means every time the scheduler runs).  When several tasks are
+	// due at once, the ones with the lowest priority number run first.
+	// Registering a function that is already registered just updates
+	// its period and priority.  Returns 1 on success, or 0 if
+	// SCHEDULER_MAX_TASKS tasks are already registered.
+	//
+	// While at least one task is registered, OrangutanTime's
+	// delayMilliseconds() and OrangutanSerial's sendBlocking() and
+	// receiveBlocking() call run() while they wait.
+	static unsigned char addTask(void (*function)(void), unsigned int period_ms, unsigned char priority);
+
+	// Unregisters a function that was registered with addTask().  When
+	// the last task is removed, OrangutanTime's idle function is cleared
+	// if it is still idle().
+	static void removeTask(void (*function)(void));
+
+	// Calls every registered task whose period has elapsed, in priority
+	// order.  Returns the number of tasks that ran.  Calls made from
+	// inside a task return 0 immediately, so tasks may use blocking
+	// library functions without recursing into the scheduler.
+	static unsigned char run();
+
+	// Like run(), but when no task was due, puts the AVR into idle sleep
+	// until the next interrupt (at most about 102 us later, when the
+	// OrangutanTime timer overflows) instead of returning to a busy
+	// loop.  This is what the blocking library functions call.  It does
+	// not sleep when called through OrangutanTime::poll(), which
+	// OrangutanSerial uses while waiting on a port in SERIAL_CHECK mode.
+	static void idle();
+
+	// Enables (the default) or disables sleeping in idle().  Disable it
+	// if your program polls hardware that cannot wake the AVR and
+	// cannot tolerate the extra latency.
+	static inline void setSleepWhenIdle(unsigned char enable) { sleepWhenIdle = enable; }
+
+	static inline unsigned char getTaskCount() { return taskCount; }
+
+  private:
+
+	static SchedulerTask tasks[SCHEDULER_MAX_TASKS];	// sorted by priority
+	static unsigned char taskCount;
+	static unsigned char running;
+	static unsigned char sleepWhenIdle;
+};
+
+extern "C" {
+#endif // __cplusplus
+
+unsigned char scheduler_add_task(void (*function)(void), unsigned int period_ms, unsigned char priority);
+void scheduler_remove_task(void (*function)(void));
+unsigned char scheduler_run(void);
+void scheduler_idle(void);
+void scheduler_set_sleep_when_idle(unsigned char enable);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
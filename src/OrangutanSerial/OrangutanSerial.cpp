@@ -29,6 +29,8 @@
 #include "../OrangutanTime/OrangutanTime.h"
 #include "../OrangutanSVP/OrangutanSVP.h"
 #include "../OrangutanX2/OrangutanX2.h"
+#include "../OrangutanDigital/OrangutanDigital.h"
+#include "../OrangutanProfiler/OrangutanProfiler.h"
 #include "../OrangutanResources/include/OrangutanModel.h"
 
 #include <avr/io.h>
@@ -40,6 +42,11 @@ extern "C" void serial_check()
 	OrangutanSerial::check();
 }
 
+extern "C" void serial_dispatch_callbacks()
+{
+	OrangutanSerial::dispatchCallbacks();
+}
+
 #if _SERIAL_PORTS > 1
 
 /** MULTI-PORT C FUNCTIONS ****************************************************/
@@ -111,6 +118,52 @@ extern "C" char serial_send_buffer_empty(unsigned char port)
 	return OrangutanSerial::sendBufferEmpty(port);
 }
 
+extern "C" FILE *serial_init_printf(unsigned char port, char *buffer, unsigned char size, unsigned char policy)
+{
+	return OrangutanSerial::initPrintf(port, buffer, size, policy);
+}
+
+extern "C" unsigned int serial_get_printf_dropped(unsigned char port)
+{
+	return OrangutanSerial::getPrintfDropped(port);
+}
+
+extern "C" void serial_flush_printf(unsigned char port)
+{
+	OrangutanSerial::flushPrintf(port);
+}
+
+extern "C" void serial_set_flow_control(unsigned char port, unsigned char mode)
+{
+	OrangutanSerial::setFlowControl(port, mode);
+}
+
+extern "C" void serial_set_flow_control_pins(unsigned char port, unsigned char rts_pin, unsigned char cts_pin)
+{
+	OrangutanSerial::setFlowControlPins(port, rts_pin, cts_pin);
+}
+
+extern "C" void serial_throttle_receive(unsigned char port, unsigned char stop)
+{
+	OrangutanSerial::throttleReceive(port, stop);
+}
+
+extern "C" char serial_is_send_stopped(unsigned char port)
+{
+	return OrangutanSerial::isSendStopped(port);
+}
+
+extern "C" void serial_set_frame_callback(unsigned char port, char *buffer, unsigned char size, unsigned int delimiter,
+	void (*callback)(char *frame, unsigned char length), unsigned char dispatch)
+{
+	OrangutanSerial::setFrameCallback(port, buffer, size, delimiter, callback, dispatch);
+}
+
+extern "C" unsigned int serial_get_frame_dropped_bytes(unsigned char port)
+{
+	return OrangutanSerial::getFrameDroppedBytes(port);
+}
+
 #else
 
 /** SINGLE-PORT C FUNCTIONS ***************************************************/
@@ -183,6 +236,52 @@ extern "C" char serial_send_buffer_empty()
 	return OrangutanSerial::sendBufferEmpty();
 }
 
+extern "C" FILE *serial_init_printf(char *buffer, unsigned char size, unsigned char policy)
+{
+	return OrangutanSerial::initPrintf(buffer, size, policy);
+}
+
+extern "C" unsigned int serial_get_printf_dropped()
+{
+	return OrangutanSerial::getPrintfDropped();
+}
+
+extern "C" void serial_flush_printf()
+{
+	OrangutanSerial::flushPrintf();
+}
+
+extern "C" void serial_set_flow_control(unsigned char mode)
+{
+	OrangutanSerial::setFlowControl(mode);
+}
+
+extern "C" void serial_set_flow_control_pins(unsigned char rts_pin, unsigned char cts_pin)
+{
+	OrangutanSerial::setFlowControlPins(rts_pin, cts_pin);
+}
+
+extern "C" void serial_throttle_receive(unsigned char stop)
+{
+	OrangutanSerial::throttleReceive(stop);
+}
+
+extern "C" char serial_is_send_stopped()
+{
+	return OrangutanSerial::isSendStopped();
+}
+
+extern "C" void serial_set_frame_callback(char *buffer, unsigned char size, unsigned int delimiter,
+	void (*callback)(char *frame, unsigned char length), unsigned char dispatch)
+{
+	OrangutanSerial::setFrameCallback(buffer, size, delimiter, callback, dispatch);
+}
+
+extern "C" unsigned int serial_get_frame_dropped_bytes()
+{
+	return OrangutanSerial::getFrameDroppedBytes();
+}
+
 #endif
 
 
@@ -190,49 +289,80 @@ extern "C" char serial_send_buffer_empty()
 
 /** SINGLE-PORT C++ FUNCTIONS *************************************************/
 // C++ Functions for devices with one UART.  No port argument is necessary.
-// These functions call the multi-port C++ functions which are inline because
-// they are declared with _SINGLE_PORT_INLINE, so the compiler will know ahead of
-// time that the port argument to those is going to be zero and it can make a lot
-// of optimizations in these functions.
+// These functions call the SerialPort<0> functions, which are compiled with
+// the port known ahead of time so the compiler can make a lot of
+// optimizations in them.
 
 void OrangutanSerial::setBaudRate(unsigned long baud)
 {
-	setBaudRate(0, baud);
+	SerialPort<0>::setBaudRate(baud);
 }
 
 void OrangutanSerial::setMode(unsigned char mode)
 {
-	setMode(0, mode);
+	SerialPort<0>::setMode(mode);
 }
 
 void OrangutanSerial::receive(char *buffer, unsigned char size)
 {
-	receive(0, buffer, size);
+	SerialPort<0>::receive(buffer, size);
 }
 
 char OrangutanSerial::receiveBlocking(char *buffer, unsigned char size, unsigned int timeout_ms)
 {
-	return receiveBlocking(0, buffer, size, timeout_ms);
+	return SerialPort<0>::receiveBlocking(buffer, size, timeout_ms);
 }
 
 void OrangutanSerial::receiveRing(char *buffer, unsigned char size)
 {
-	receiveRing(0, buffer, size);
+	SerialPort<0>::receiveRing(buffer, size);
 }
 
 void OrangutanSerial::cancelReceive()
 {
-	cancelReceive(0);
+	SerialPort<0>::cancelReceive();
 }
 
 void OrangutanSerial::send(char *buffer, unsigned char size)
 {
-	send(0, buffer, size);
+	PROFILE_SCOPE(serial_send);
+	SerialPort<0>::send(buffer, size);
 }
 
 void OrangutanSerial::sendBlocking(char *message, unsigned char size)
 {
-	sendBlocking(0, message, size);
+	SerialPort<0>::sendBlocking(message, size);
+}
+
+FILE *OrangutanSerial::initPrintf(char *buffer, unsigned char size, unsigned char policy)
+{
+	return SerialPort<0>::initPrintf(buffer, size, policy);
+}
+
+void OrangutanSerial::flushPrintf()
+{
+	SerialPort<0>::flushPrintf();
+}
+
+void OrangutanSerial::setFlowControl(unsigned char mode)
+{
+	SerialPort<0>::setFlowControl(mode);
+}
+
+void OrangutanSerial::setFlowControlPins(unsigned char rts_pin, unsigned char cts_pin)
+{
+	SerialPort<0>::setFlowControlPins(rts_pin, cts_pin);
+}
+
+void OrangutanSerial::throttleReceive(unsigned char stop)
+{
+	SerialPort<0>::throttleReceive(stop);
+}
+
+void OrangutanSerial::setFrameCallback(char *buffer, unsigned char size, unsigned int delimiter,
+	void (*callback)(char *frame, unsigned char length), unsigned char dispatch)
+{
+	SerialPort<0>::setFrameCallback(buffer, size, delimiter, callback, dispatch);
 }
 #endif
 
@@ -240,13 +370,19 @@ void OrangutanSerial::sendBlocking(char *message, unsigned char size)
 
 SerialPortData OrangutanSerial::ports[_SERIAL_PORTS] =
 {
-	{mode:SERIAL_AUTOMATIC, sentBytes:0, receivedBytes:0, sendSize:0, receiveSize:0, receiveRingOn:0, sendBuffer:0, receiveBuffer:0},
+	{mode:SERIAL_AUTOMATIC, sentBytes:0, receivedBytes:0, sendSize:0, receiveSize:0, receiveRingOn:0, sendRingOn:0, sendRingHead:0, droppedBytes:0, sendBuffer:0, receiveBuffer:0},
 #if _SERIAL_PORTS > 1
-	{mode:SERIAL_AUTOMATIC, sentBytes:0, receivedBytes:0, sendSize:0, receiveSize:0, receiveRingOn:0, sendBuffer:0, receiveBuffer:0},
-	{mode:SERIAL_CHECK,     sentBytes:0, receivedBytes:0, sendSize:0, receiveSize:0, receiveRingOn:0, sendBuffer:0, receiveBuffer:0},
+	{mode:SERIAL_AUTOMATIC, sentBytes:0, receivedBytes:0, sendSize:0, receiveSize:0, receiveRingOn:0, sendRingOn:0, sendRingHead:0, droppedBytes:0, sendBuffer:0, receiveBuffer:0},
+	{mode:SERIAL_CHECK,     sentBytes:0, receivedBytes:0, sendSize:0, receiveSize:0, receiveRingOn:0, sendRingOn:0, sendRingHead:0, droppedBytes:0, sendBuffer:0, receiveBuffer:0},
 #endif
 };
 
+void (* volatile OrangutanSerial::receiveHooks[_SERIAL_PORTS])(unsigned char);
+
+SerialFlowData OrangutanSerial::flow[_SERIAL_PORTS];
+
+SerialFrameData OrangutanSerial::frames[_SERIAL_PORTS];
+
 /** PRIVATE PROTOTYPES ********************************************************/
 inline void uart_update_tx_interrupt(unsigned char port);
 inline void serial_tx_check(unsigned char port);
@@ -338,29 +474,9 @@ void OrangutanSerial::initUART_inline(unsigned char port)
 	sei();
 }
 
-void OrangutanSerial::initPort(unsigned char port)
+template<unsigned char port> void SerialPort<port>::setBaudRate(unsigned long baud)
 {
-	// We use a case statement instead of just "initUART_inline(port)"
-	// because that allows us to save about 100 bytes of program space.  That's
-	// because this method allows the compiler to compute ahead of time the
-	// exact addresses of all the variables accessed by initUART_inline, so it
-	// does not need to deal with pointers.
-
-	#if _SERIAL_PORTS > 1
-	switch(port)
-	{
-		case 0:	initUART_inline(0); break; // Initialize UART0
-		case 1: initUART_inline(1); break; // Initialize UART1
-		// No initialization is required for the USB-based serial port.
-	}
-	#else
-	initUART_inline(0);
-	#endif
-}
-
-_SINGLE_PORT_INLINE void OrangutanSerial::setBaudRate(unsigned char port, unsigned long baud)
-{
-	initPort(port);
+	OrangutanSerial::initUART_inline(port);
 
 	unsigned int baud_ubrr = (F_CPU - 8*baud) / (16*baud);
 
@@ -377,12 +493,12 @@ _SINGLE_PORT_INLINE void OrangutanSerial::setBaudRate(unsigned char port, unsign
 	*ubrr(port) = baud_ubrr;
 }
 
-_SINGLE_PORT_INLINE void OrangutanSerial::setMode(unsigned char port, unsigned char mode)
+template<unsigned char port> void SerialPort<port>::setMode(unsigned char mode)
 {
-	ports[port].mode = mode;
+	OrangutanSerial::ports[port].mode = mode;
 
 	// Disable/Enable the UART RX/TX interrupts as required.
-	initPort(port);
+	OrangutanSerial::initUART_inline(port);
 }
 
 void OrangutanSerial::check()
@@ -406,6 +522,8 @@ void OrangutanSerial::check()
 	#if _SERIAL_PORTS > 2
 	serial_rx_check(2);
 	#endif
+
+	dispatchCallbacks();
 }
 
 /** RECEIVING *****************************************************************/
@@ -468,7 +586,13 @@ inline void OrangutanSerial::serial_rx_check(unsigned char port)
 		// Disable the RX interrupt so it doesn't interrupt this function.
 		*ucsrb(port) &= ~(1<<RXCIE);
 
-		if(ports[port].receiveBuffer && ports[port].receivedBytes < ports[port].receiveSize && *ucsra(port) & (1<<RXC)) // A byte has been received
+		// Without a receive buffer with room, a byte is left in the UART
+		// for the next receive() unless the hook, a frame callback or
+		// XON/XOFF needs to see it.
+		unsigned char wanted = (ports[port].receiveBuffer && ports[port].receivedBytes < ports[port].receiveSize) ||
+			receiveHooks[port] || frames[port].callback || flow[port].mode == SERIAL_FLOW_XON_XOFF;
+
+		if(wanted && *ucsra(port) & (1<<RXC)) // A byte has been received
 		{
 			serial_rx_handle_byte(port, *udr(port));
 		}
@@ -510,6 +634,33 @@ inline void OrangutanSerial::serial_rx_check(unsigned char port)
 // argument) so we needn't worry about overhead from expressions like ports[port].
 inline void OrangutanSerial::serial_rx_handle_byte(unsigned char port, unsigned char byte_received)
 {
+	if (flow[port].mode == SERIAL_FLOW_XON_XOFF && (byte_received == SERIAL_XON || byte_received == SERIAL_XOFF))
+	{
+		// The other end is pausing or resuming our sending.  These bytes
+		// are not data, so they are not passed on.
+		if (byte_received == SERIAL_XOFF)
+		{
+			flow[port].state |= SERIAL_FLOW_TX_STOPPED;
+		}
+		else
+		{
+			flow[port].state &= ~SERIAL_FLOW_TX_STOPPED;
+		}
+		uart_update_tx_interrupt(port);
+		return;
+	}
+
+	void (*hook)(unsigned char) = receiveHooks[port];
+	if (hook)
+	{
+		hook(byte_received);
+	}
+
+	if (frames[port].callback)
+	{
+		frame_handle_byte(port, byte_received);
+	}
+
 	if(ports[port].receiveBuffer && ports[port].receivedBytes < ports[port].receiveSize)
 	{
 		ports[port].receiveBuffer[ports[port].receivedBytes] = byte_received;
@@ -519,6 +670,113 @@ inline void OrangutanSerial::serial_rx_handle_byte(unsigned char port, unsigned
 	{
 		ports[port].receivedBytes = 0; // reset the ring
 	}
+
+	// Ask the other end to stop before the receive buffer overflows.
+	if (flow[port].mode != SERIAL_FLOW_NONE && !(flow[port].state & SERIAL_FLOW_RX_STOPPED) &&
+		ports[port].receiveBuffer && !ports[port].receiveRingOn &&
+		(unsigned char)(ports[port].receiveSize - ports[port].receivedBytes) <= SERIAL_FLOW_MARGIN)
+	{
+		flow_throttle(port, 1);
+	}
+}
+
+// Adds a received byte to the port's frame and, when the frame is complete,
+// calls the frame callback or marks the frame for dispatchCallbacks().
+inline void OrangutanSerial::frame_handle_byte(unsigned char port, unsigned char byte_received)
+{
+	SerialFrameData *f = &frames[port];
+
+	if (f->pending)
+	{
+		// The last frame has not been dispatched yet.
+		f->droppedBytes++;
+		return;
+	}
+
+	if (byte_received != f->delimiter)
+	{
+		f->buffer[f->length++] = byte_received;
+		if (f->length < f->size)
+		{
+			return;
+		}
+	}
+
+	if (f->dispatch == SERIAL_CALLBACK_IMMEDIATE)
+	{
+		f->callback(f->buffer, f->length);
+		f->length = 0;
+	}
+	else
+	{
+		f->pending = 1;
+	}
+}
+
+// Calls the deferred callback of a port if a frame is ready.
+inline void OrangutanSerial::frame_dispatch(unsigned char port)
+{
+	SerialFrameData *f = &frames[port];
+
+	if (f->pending)
+	{
+		f->callback(f->buffer, f->length);
+
+		// The RX interrupt leaves the frame alone while it is pending.
+		f->length = 0;
+		f->pending = 0;
+	}
+}
+
+void OrangutanSerial::dispatchCallbacks()
+{
+	// Callbacks may call blocking functions, which call check(), which
+	// calls this again.
+	static unsigned char dispatching;
+	if (dispatching)
+	{
+		return;
+	}
+	dispatching = 1;
+
+	frame_dispatch(0);
+	#if _SERIAL_PORTS > 1
+	frame_dispatch(1);
+	#endif
+
+	dispatching = 0;
+}
+
+// Asks the other end to stop or continue sending.  Must be called with
+// interrupts disabled (or from the RX interrupt).
+inline void OrangutanSerial::flow_throttle(unsigned char port, unsigned char stop)
+{
+	if (stop)
+	{
+		flow[port].state |= SERIAL_FLOW_RX_STOPPED;
+	}
+	else
+	{
+		flow[port].state &= ~SERIAL_FLOW_RX_STOPPED;
+	}
+
+	if (flow[port].mode == SERIAL_FLOW_RTS_CTS)
+	{
+		if (stop)
+		{
+			*flow[port].rtsPort |= flow[port].rtsMask;
+		}
+		else
+		{
+			*flow[port].rtsPort &= ~flow[port].rtsMask;
+		}
+	}
+	else if (flow[port].mode == SERIAL_FLOW_XON_XOFF)
+	{
+		// The TX interrupt sends the XON or XOFF ahead of any data.
+		flow[port].state |= SERIAL_FLOW_SEND_CONTROL;
+		uart_update_tx_interrupt(port);
+	}
 }
 
 inline void OrangutanSerial::receive_inline(unsigned char port, char * buffer, unsigned char size, unsigned char receiveRingOn)
@@ -534,6 +792,15 @@ inline void OrangutanSerial::receive_inline(unsigned char port, char * buffer, u
 	ports[port].receiveSize = size;
 	ports[port].receiveRingOn = receiveRingOn;
 
+	// There is room again, so let the other end continue.
+	if (flow[port].state & SERIAL_FLOW_RX_STOPPED)
+	{
+		unsigned char sreg = SREG;
+		cli();
+		flow_throttle(port, 0);
+		SREG = sreg;
+	}
+
 	if (_PORT_IS_UART && ports[port].mode == SERIAL_AUTOMATIC)
 	{
 		// Re-enable the RX interrupt so background receiving will work.
@@ -541,22 +808,32 @@ inline void OrangutanSerial::receive_inline(unsigned char port, char * buffer, u
 	}
 }
 
-_SINGLE_PORT_INLINE void OrangutanSerial::receive(unsigned char port, char *buffer, unsigned char size)
+// In SERIAL_CHECK mode only check() moves bytes, so the idle function
+// must not sleep: the scheduler's idle sleep can outlast a byte time.
+template<unsigned char port> inline void SerialPort<port>::idle()
 {
-	receive_inline(port, buffer, size, 0);
+	if (getMode() == SERIAL_CHECK)
+		OrangutanTime::poll();
+	else
+		OrangutanTime::idle();
 }
 
-_SINGLE_PORT_INLINE char OrangutanSerial::receiveBlocking(unsigned char port, char *buffer, unsigned char size, unsigned int timeout_ms)
+template<unsigned char port> void SerialPort<port>::receive(char *buffer, unsigned char size)
 {
-	receive(port, buffer, size);
+	OrangutanSerial::receive_inline(port, buffer, size, 0);
+}
+
+template<unsigned char port> char SerialPort<port>::receiveBlocking(char *buffer, unsigned char size, unsigned int timeout_ms)
+{
+	receive(buffer, size);
 
 	unsigned long start_time = get_ms();
 
 	while(1)
 	{
-	    check();
+	    OrangutanSerial::check();
 
-		if (receiveBufferFull(port))
+		if (receiveBufferFull())
 		{
 			return 0; // Success
 		}
@@ -565,17 +842,19 @@ _SINGLE_PORT_INLINE char OrangutanSerial::receiveBlocking(unsigned char port, ch
 		{
 			return 1; // Timeout
 		}
+
+		idle();
 	}
 }
 
-_SINGLE_PORT_INLINE void OrangutanSerial::receiveRing(unsigned char port, char *buffer, unsigned char size)
+template<unsigned char port> void SerialPort<port>::receiveRing(char *buffer, unsigned char size)
 {
-	receive_inline(port, buffer, size, 1);
+	OrangutanSerial::receive_inline(port, buffer, size, 1);
 }
 
-_SINGLE_PORT_INLINE void OrangutanSerial::cancelReceive(unsigned char port)
+template<unsigned char port> void SerialPort<port>::cancelReceive()
 {
-	receive(port,0,0);
+	receive(0,0);
 }
 
 #ifdef USART_RX_vect
@@ -615,7 +894,8 @@ inline void uart_disable_tx_interrupt(unsigned char port)
 // are requesting interrupts.  Otherwise, disable it.
 inline void OrangutanSerial::uart_update_tx_interrupt(unsigned char port)
 {
-	if(ports[port].sendBuffer && ports[port].sentBytes < ports[port].sendSize && ports[port].mode == SERIAL_AUTOMATIC)
+	if(ports[port].mode == SERIAL_AUTOMATIC &&
+		((sendPending(port) && !(flow[port].state & SERIAL_FLOW_TX_STOPPED)) || (flow[port].state & SERIAL_FLOW_SEND_CONTROL)))
 	{
 		uart_enable_tx_interrupt(port);
 	}
@@ -642,7 +922,7 @@ inline void OrangutanSerial::serial_tx_check(unsigned char port)
 	{
 		while(1)
 		{
-			if(!ports[USB_COMM].sendBuffer || ports[USB_COMM].sentBytes >= ports[USB_COMM].sendSize)
+			if(!sendPending(USB_COMM))
 			{
 				// Return because we have nothing (more) to send.
 				return;
@@ -651,7 +931,7 @@ inline void OrangutanSerial::serial_tx_check(unsigned char port)
 			if (SEND_BYTE_IF_READY(ports[USB_COMM].sendBuffer[ports[USB_COMM].sentBytes]))
 			{
 				// We successfully started sending a byte
-				ports[USB_COMM].sentBytes++;
+				advanceSentBytes(USB_COMM);
 
 				// Try to send another byte.
 				continue;
@@ -664,12 +944,50 @@ inline void OrangutanSerial::serial_tx_check(unsigned char port)
 	#endif
 }
 
+// Moves on to the next byte of the send buffer, wrapping around in ring mode.
+inline void OrangutanSerial::advanceSentBytes(unsigned char port)
+{
+	unsigned char sent = ports[port].sentBytes + 1;
+	if (ports[port].sendRingOn && sent == ports[port].sendSize)
+	{
+		sent = 0;
+	}
+	ports[port].sentBytes = sent;
+}
+
+// Returns true if the other end has paused our sending.  With RTS/CTS,
+// CTS is checked here before every byte; flowControlTick() notices when it
+// goes low again.
+inline char OrangutanSerial::flow_tx_stopped(unsigned char port)
+{
+	if (flow[port].mode == SERIAL_FLOW_RTS_CTS)
+	{
+		if (*flow[port].ctsPin & flow[port].ctsMask)
+		{
+			flow[port].state |= SERIAL_FLOW_TX_STOPPED;
+		}
+		else
+		{
+			flow[port].state &= ~SERIAL_FLOW_TX_STOPPED;
+		}
+	}
+	return flow[port].state & SERIAL_FLOW_TX_STOPPED;
+}
+
 inline void OrangutanSerial::uart_tx_isr(unsigned char port)
 {
-	if(ports[port].sendBuffer && ports[port].sentBytes < ports[port].sendSize && *ucsra(port) & (1<<UDRE))
+	if (*ucsra(port) & (1<<UDRE))
 	{
-	    *udr(port) = ports[port].sendBuffer[ports[port].sentBytes];
-		ports[port].sentBytes++; // we started sending a byte
+		if (flow[port].state & SERIAL_FLOW_SEND_CONTROL)
+		{
+			*udr(port) = (flow[port].state & SERIAL_FLOW_RX_STOPPED) ? SERIAL_XOFF : SERIAL_XON;
+			flow[port].state &= ~SERIAL_FLOW_SEND_CONTROL;
+		}
+		else if (sendPending(port) && !flow_tx_stopped(port))
+		{
+		    *udr(port) = ports[port].sendBuffer[ports[port].sentBytes];
+			advanceSentBytes(port); // we started sending a byte
+		}
 	}
 
 	// If called from an interrupt, this will disable the interrupt so we don't get called again.
@@ -677,25 +995,304 @@ inline void OrangutanSerial::uart_tx_isr(unsigned char port)
 	uart_update_tx_interrupt(port);
 }
 
-_SINGLE_PORT_INLINE void OrangutanSerial::send(unsigned char port, char *buffer, unsigned char size)
+template<unsigned char port> void SerialPort<port>::send(char *buffer, unsigned char size)
 {
-	ports[port].sendBuffer = buffer;
-	ports[port].sentBytes = 0;
-	ports[port].sendSize = size;
+	// Keep the UDRE interrupt from running while the buffer changes: it
+	// must not see the new buffer with the old printf ring position, or
+	// ring mode turned off before the new size and position are in.
+	if (_PORT_IS_UART)
+	{
+		uart_disable_tx_interrupt(port);
+	}
+
+	OrangutanSerial::ports[port].sendBuffer = buffer;
+	OrangutanSerial::ports[port].sendSize = size;
+	OrangutanSerial::ports[port].sentBytes = 0;
+	OrangutanSerial::ports[port].sendRingOn = 0;
 
 	// enable the interrupts, and everything will be started by the ISR
 	if (_PORT_IS_UART)
 	{
-		uart_update_tx_interrupt(port);
+		OrangutanSerial::uart_update_tx_interrupt(port);
 	}
 }
 
-_SINGLE_PORT_INLINE void OrangutanSerial::sendBlocking(unsigned char port, char *buffer, unsigned char size)
+template<unsigned char port> void SerialPort<port>::sendBlocking(char *buffer, unsigned char size)
 {
-	send(port, buffer, size);
+	send(buffer, size);
 
 	// wait for sending before returning
-	while(!sendBufferEmpty(port)){ check(); }
+	while(!sendBufferEmpty()){ OrangutanSerial::check(); idle(); }
+}
+
+/** PRINTF ********************************************************************/
+
+template<unsigned char port> FILE SerialPort<port>::stream;
+
+template<unsigned char port> FILE *SerialPort<port>::initPrintf(char *buffer, unsigned char size, unsigned char policy)
+{
+	// Stop any transmission in progress before switching to the ring.
+	if (_PORT_IS_UART)
+	{
+		uart_disable_tx_interrupt(port);
+	}
+
+	OrangutanSerial::ports[port].sendBuffer = buffer;
+	OrangutanSerial::ports[port].sendSize = size;
+	OrangutanSerial::ports[port].sentBytes = 0;
+	OrangutanSerial::ports[port].sendRingHead = 0;
+	OrangutanSerial::ports[port].droppedBytes = 0;
+	OrangutanSerial::ports[port].sendRingOn = policy;
+
+	fdev_setup_stream(&stream, printfPutChar, 0, _FDEV_SETUP_WRITE);
+	if (stdout == 0)
+	{
+		stdout = &stream;
+	}
+	return &stream;
+}
+
+// This function is called by printf.  It only stores the character in the
+// ring; the UDRE interrupt (or check(), in SERIAL_CHECK mode) sends it.
+template<unsigned char port> int SerialPort<port>::printfPutChar(char c, FILE *f)
+{
+	SerialPortData *data = &OrangutanSerial::ports[port];
+
+	if (!data->sendRingOn)
+	{
+		// send() took the port over
+		return _FDEV_ERR;
+	}
+
+	unsigned char head = data->sendRingHead;
+	unsigned char next = head + 1;
+	if (next == data->sendSize)
+	{
+		next = 0;
+	}
+
+	while (next == data->sentBytes)
+	{
+		// The ring is full.
+		if (data->sendRingOn != SERIAL_PRINTF_BLOCK)
+		{
+			data->droppedBytes++;
+			return 0;
+		}
+		OrangutanSerial::check();
+		idle();
+	}
+
+	data->sendBuffer[head] = c;
+	data->sendRingHead = next;
+
+	if (_PORT_IS_UART)
+	{
+		OrangutanSerial::uart_update_tx_interrupt(port);
+	}
+	return 0;
+}
+
+template<unsigned char port> void SerialPort<port>::flushPrintf()
+{
+	while(!sendBufferEmpty()){ OrangutanSerial::check(); idle(); }
+}
+
+/** FRAME CALLBACKS ***********************************************************/
+
+template<unsigned char port> void SerialPort<port>::setFrameCallback(char *buffer, unsigned char size, unsigned int delimiter,
+	void (*callback)(char *frame, unsigned char length), unsigned char dispatch)
+{
+	if (!_PORT_IS_UART)
+	{
+		return;
+	}
+
+	SerialFrameData *f = &OrangutanSerial::frames[port];
+
+	unsigned char sreg = SREG;
+	cli();
+	f->callback = size ? callback : 0;
+	f->buffer = buffer;
+	f->size = size;
+	f->length = 0;
+	f->delimiter = delimiter;
+	f->dispatch = dispatch;
+	f->pending = 0;
+	f->droppedBytes = 0;
+	SREG = sreg;
+}
+
+/** FLOW CONTROL **************************************************************/
+
+template<unsigned char port> void SerialPort<port>::setFlowControlPins(unsigned char rts_pin, unsigned char cts_pin)
+{
+	struct IOStruct io;
+
+	OrangutanDigital::getIORegisters(&io, rts_pin);
+	OrangutanSerial::flow[port].rtsPort = io.portRegister;
+	OrangutanSerial::flow[port].rtsMask = io.bitmask;
+	OrangutanDigital::setOutput(rts_pin, LOW);	// ready to receive
+
+	OrangutanDigital::getIORegisters(&io, cts_pin);
+	OrangutanSerial::flow[port].ctsPin = io.pinRegister;
+	OrangutanSerial::flow[port].ctsMask = io.bitmask;
+	OrangutanDigital::setInput(cts_pin, HIGH_IMPEDANCE);
+}
+
+template<unsigned char port> void SerialPort<port>::setFlowControl(unsigned char mode)
+{
+	if (!_PORT_IS_UART || (mode == SERIAL_FLOW_RTS_CTS && OrangutanSerial::flow[port].ctsPin == 0))
+	{
+		return;
+	}
+
+	unsigned char sreg = SREG;
+	cli();
+	OrangutanSerial::flow[port].mode = mode;
+	OrangutanSerial::flow[port].state = 0;
+	if (mode == SERIAL_FLOW_RTS_CTS)
+	{
+		*OrangutanSerial::flow[port].rtsPort &= ~OrangutanSerial::flow[port].rtsMask;
+	}
+	OrangutanSerial::uart_update_tx_interrupt(port);
+	SREG = sreg;
+
+	// Resuming after CTS goes low again is polled every millisecond.
+	OrangutanTime::removeMillisecondCallback(OrangutanSerial::flowControlTick);
+	for (unsigned char i = 0; i < _SERIAL_PORTS; i++)
+	{
+		if (OrangutanSerial::flow[i].mode == SERIAL_FLOW_RTS_CTS)
+		{
+			OrangutanTime::addMillisecondCallback(OrangutanSerial::flowControlTick);
+			break;
+		}
+	}
+}
+
+template<unsigned char port> void SerialPort<port>::throttleReceive(unsigned char stop)
+{
+	if (OrangutanSerial::flow[port].mode == SERIAL_FLOW_NONE)
+	{
+		return;
+	}
+
+	unsigned char sreg = SREG;
+	cli();
+	OrangutanSerial::flow_throttle(port, stop);
+	SREG = sreg;
+}
+
+// Called every millisecond while a port uses RTS/CTS, to restart sending
+// once CTS goes low again.
+void OrangutanSerial::flowControlTick()
+{
+	unsigned char sreg = SREG;
+	cli();
+	if ((flow[0].state & SERIAL_FLOW_TX_STOPPED) && !flow_tx_stopped(0))
+	{
+		uart_update_tx_interrupt(0);
+	}
+	#if _SERIAL_PORTS > 1
+	if ((flow[1].state & SERIAL_FLOW_TX_STOPPED) && !flow_tx_stopped(1))
+	{
+		uart_update_tx_interrupt(1);
+	}
+	#endif
+	SREG = sreg;
+}
+
+/** PORT DISPATCH *************************************************************/
+
+// One copy of the SerialPort functions is compiled for each port.
+template class SerialPort<0>;
+#if _SERIAL_PORTS > 1
+template class SerialPort<1>;
+template class SerialPort<2>;
+
+// Calls the SerialPort<port> version of a function for a port number that is
+// only known at run time.
+#define SERIAL_PORT_DISPATCH(call) \
+	switch(port) \
+	{ \
+		case 0: return SerialPort<0>::call; \
+		case 1: return SerialPort<1>::call; \
+		default: return SerialPort<2>::call; \
+	}
+#else
+#define SERIAL_PORT_DISPATCH(call) return SerialPort<0>::call
+#endif
+
+_SINGLE_PORT_INLINE void OrangutanSerial::setBaudRate(unsigned char port, unsigned long baud)
+{
+	SERIAL_PORT_DISPATCH(setBaudRate(baud));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::setMode(unsigned char port, unsigned char mode)
+{
+	SERIAL_PORT_DISPATCH(setMode(mode));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::receive(unsigned char port, char *buffer, unsigned char size)
+{
+	SERIAL_PORT_DISPATCH(receive(buffer, size));
+}
+
+_SINGLE_PORT_INLINE char OrangutanSerial::receiveBlocking(unsigned char port, char *buffer, unsigned char size, unsigned int timeout_ms)
+{
+	SERIAL_PORT_DISPATCH(receiveBlocking(buffer, size, timeout_ms));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::receiveRing(unsigned char port, char *buffer, unsigned char size)
+{
+	SERIAL_PORT_DISPATCH(receiveRing(buffer, size));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::cancelReceive(unsigned char port)
+{
+	SERIAL_PORT_DISPATCH(cancelReceive());
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::send(unsigned char port, char *buffer, unsigned char size)
+{
+	PROFILE_SCOPE(serial_send);
+	SERIAL_PORT_DISPATCH(send(buffer, size));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::sendBlocking(unsigned char port, char *buffer, unsigned char size)
+{
+	SERIAL_PORT_DISPATCH(sendBlocking(buffer, size));
+}
+
+_SINGLE_PORT_INLINE FILE *OrangutanSerial::initPrintf(unsigned char port, char *buffer, unsigned char size, unsigned char policy)
+{
+	SERIAL_PORT_DISPATCH(initPrintf(buffer, size, policy));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::flushPrintf(unsigned char port)
+{
+	SERIAL_PORT_DISPATCH(flushPrintf());
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::setFlowControl(unsigned char port, unsigned char mode)
+{
+	SERIAL_PORT_DISPATCH(setFlowControl(mode));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::setFlowControlPins(unsigned char port, unsigned char rts_pin, unsigned char cts_pin)
+{
+	SERIAL_PORT_DISPATCH(setFlowControlPins(rts_pin, cts_pin));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::throttleReceive(unsigned char port, unsigned char stop)
+{
+	SERIAL_PORT_DISPATCH(throttleReceive(stop));
+}
+
+_SINGLE_PORT_INLINE void OrangutanSerial::setFrameCallback(unsigned char port, char *buffer, unsigned char size,
+	unsigned int delimiter, void (*callback)(char *frame, unsigned char length), unsigned char dispatch)
+{
+	SERIAL_PORT_DISPATCH(setFrameCallback(buffer, size, delimiter, callback, dispatch));
 }
 
 #ifdef USART_UDRE_vect
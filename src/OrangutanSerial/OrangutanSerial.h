@@ -27,6 +27,7 @@
 #include "../OrangutanResources/include/OrangutanModel.h"
 
 #include <avr/interrupt.h>
+#include <stdio.h>
 
 #if defined(_ORANGUTAN_SVP)
  // The Orangutan SVP has two UARTs and one virtual COM port via USB.
@@ -62,22 +63,81 @@
 #define SERIAL_AUTOMATIC 0
 #define SERIAL_CHECK 1
 
+// What the printf stream does when its send ring is full.
+#define SERIAL_PRINTF_DROP 1	// discard the character and count it
+#define SERIAL_PRINTF_BLOCK 2	// wait for space
+
+// Flow control modes for setFlowControl().
+#define SERIAL_FLOW_NONE 0
+#define SERIAL_FLOW_XON_XOFF 1
+#define SERIAL_FLOW_RTS_CTS 2
+
+#define SERIAL_XON 0x11
+#define SERIAL_XOFF 0x13
+
+// With flow control on, the other end is told to stop sending once only
+// this many bytes are left in the receive buffer.
+#ifndef SERIAL_FLOW_MARGIN
+#define SERIAL_FLOW_MARGIN 8
+#endif
+
+// How setFrameCallback() calls its function.
+#define SERIAL_CALLBACK_IMMEDIATE 0	// from the RX interrupt
+#define SERIAL_CALLBACK_DEFERRED 1	// from dispatchCallbacks()
+
+// Pass this as the delimiter to setFrameCallback() for fixed-length frames.
+#define SERIAL_NO_DELIMITER 0x100
+
+// SerialFlowData state bits.
+#define SERIAL_FLOW_TX_STOPPED 1	// the other end asked us to stop sending
+#define SERIAL_FLOW_RX_STOPPED 2	// we asked the other end to stop sending
+#define SERIAL_FLOW_SEND_CONTROL 4	// an XON or XOFF needs to be sent
+
 #ifdef __cplusplus
 
 typedef struct SerialPortData
 {
 	unsigned char mode;	// SERIAL_AUTOMATIC (interrupt-driven) or SERIAL_CHECK
-	volatile unsigned char sentBytes;
+	volatile unsigned char sentBytes;	// in ring mode, index of the next byte to send
 	volatile unsigned char receivedBytes;
 	unsigned char sendSize;
 	unsigned char receiveSize;
 	unsigned char receiveRingOn; // boolean
+	unsigned char sendRingOn;	// 0, or the SERIAL_PRINTF_* policy
+	volatile unsigned char sendRingHead;	// index where the next byte gets stored
+	unsigned int droppedBytes;
 	char *sendBuffer;
 	char *receiveBuffer;
 } SerialPortData;
 
+typedef struct SerialFlowData
+{
+	unsigned char mode;	// SERIAL_FLOW_*
+	volatile unsigned char state;	// SERIAL_FLOW_* state bits
+	volatile unsigned char *rtsPort;
+	volatile unsigned char *ctsPin;
+	unsigned char rtsMask;
+	unsigned char ctsMask;
+} SerialFlowData;
+
+typedef struct SerialFrameData
+{
+	void (*callback)(char *frame, unsigned char length);
+	char *buffer;
+	unsigned char size;
+	unsigned char length;	// bytes collected so far
+	unsigned int delimiter;	// or SERIAL_NO_DELIMITER
+	unsigned char dispatch;	// SERIAL_CALLBACK_*
+	volatile unsigned char pending;	// a deferred frame is waiting
+	volatile unsigned int droppedBytes;
+} SerialFrameData;
+
+template<unsigned char port> class SerialPort;
+
 class OrangutanSerial
 {
+	template<unsigned char port> friend class SerialPort;
+
   public:
 
 	// Constructor (doesn't do anything).
@@ -136,6 +196,90 @@ class OrangutanSerial
 
 	// sendBufferEmpty: True when the send buffer is empty.
 
+	// setReceiveHook: Registers a function that gets called from the RX
+	// interrupt with every byte received on a UART, before the byte is
+	// stored in the receive buffer.  The function runs with interrupts
+	// disabled, so it should be short: at high baud rates it must return
+	// within one character time (about 87 us at 115200 baud) or bytes
+	// will be lost, and it must not call blocking library functions.
+	// Pass 0 to remove it.  This is how protocol layers such as
+	// OrangutanSerialBus see each byte as soon as it arrives.  In
+	// SERIAL_CHECK mode it is called from check() instead, whether or
+	// not a receive buffer is set up.
+
+	// setFrameCallback: Collects the bytes received on a UART into
+	// buffer and calls callback(buffer, length) each time a frame is
+	// complete: when the delimiter byte arrives (the delimiter itself is
+	// not stored) or when size bytes have been collected.  With
+	// SERIAL_NO_DELIMITER, every frame is size bytes long.  This works
+	// alongside receive() and the receive hook, which still see every
+	// byte.  With SERIAL_CALLBACK_IMMEDIATE, callback runs in the RX
+	// interrupt, under the same constraints as the receive hook; use
+	// this for urgent commands such as an emergency stop.  With
+	// SERIAL_CALLBACK_DEFERRED, the interrupt only marks the frame as
+	// ready and callback runs from dispatchCallbacks(), so it may take
+	// as long as it needs and call any library function; until then,
+	// further bytes are dropped (see getFrameDroppedBytes()).  Pass a
+	// callback of 0 to stop.  In SERIAL_CHECK mode, bytes are collected
+	// by check(), so SERIAL_CALLBACK_IMMEDIATE callbacks run from there.
+
+	// dispatchCallbacks: Calls the deferred frame callbacks of all ports
+	// that have a frame ready.  check() and the blocking functions call
+	// it, so your program only needs to call it (or register it with
+	// OrangutanScheduler::addTask()) if it uses deferred callbacks
+	// without waiting in those functions.
+
+	// initPrintf: Sets up a stdio stream that writes to the serial port
+	// and returns it, so you can use fprintf(stream, ...).  If stdout is
+	// not set up yet, it is also made stdout, so printf() works too
+	// (like OrangutanLCD::initPrintf(), which sets stdout if it is
+	// called first).  Characters are copied into buffer, which is used
+	// as a ring of size bytes (at most size-1 pending), and sent in the
+	// background, so printing returns as soon as the characters are
+	// stored.  When the ring is full, policy decides whether characters
+	// are dropped (SERIAL_PRINTF_DROP; see getPrintfDropped()) or the
+	// caller waits for space (SERIAL_PRINTF_BLOCK).  Characters are not
+	// translated, so print "\r\n" if your terminal needs it.  In
+	// SERIAL_CHECK mode, including on USB_COMM, check() must be called
+	// for the characters to go out.  Calling send() or sendBlocking()
+	// stops the ring and discards anything still in it.
+
+	// getPrintfDropped: Returns the number of characters the printf
+	// stream has dropped because its ring was full.
+
+	// flushPrintf: Waits until everything printed has started sending.
+
+	// setFlowControl: Turns flow control on a UART on or off.  With
+	// SERIAL_FLOW_XON_XOFF, receiving an XOFF character (0x13) pauses
+	// sending until an XON (0x11) arrives; these two characters are not
+	// stored in the receive buffer, so the data itself must not contain
+	// them.  With SERIAL_FLOW_RTS_CTS, sending pauses while the CTS input
+	// is high; the pins must be set first with setFlowControlPins().  In
+	// both modes, once receive() has filled all but SERIAL_FLOW_MARGIN
+	// bytes of the receive buffer, the other end is asked to stop (by
+	// sending XOFF or driving RTS high), and the next call to receive()
+	// or receiveRing() asks it to continue.  A ring buffer never fills,
+	// so in ring mode call throttleReceive() yourself when your code
+	// falls behind.
+
+	// setFlowControlPins: Sets the pins used for RTS (an output, driven
+	// low while we can receive) and CTS (an input, low while the other
+	// end can receive) with SERIAL_FLOW_RTS_CTS.  Pins are specified as
+	// for OrangutanDigital, e.g. IO_D4.
+
+	// throttleReceive: Asks the other end to stop (stop = 1) or continue
+	// (stop = 0) sending.
+
+	// isSendStopped: True while the other end has paused our sending.
+
+	// On devices with more than one port, the functions that take a port
+	// argument work out which port's registers and data to use at run
+	// time.  If the port is known when you write the code, use the same
+	// functions from SerialPort<port> (below) instead: they are compiled
+	// separately for each port, with the register and variable addresses
+	// built in.  The functions here just call the SerialPort<port>
+	// version for the port they are given.
+
 #if _SERIAL_PORTS == 1
 	static void setBaudRate(unsigned long baud);
 	static void setMode(unsigned char mode);
@@ -145,13 +289,26 @@ class OrangutanSerial
 	static void cancelReceive();
 	static void send(char *buffer, unsigned char size);
 	static void sendBlocking(char *buffer, unsigned char size);
-	static inline char sendBufferEmpty() { return ports[0].sentBytes == ports[0].sendSize; }
+	static inline char sendBufferEmpty() { return !sendPending(0); }
 	static inline unsigned char getSentBytes() { return ports[0].sentBytes; }
 	static inline unsigned char getReceivedBytes() { return ports[0].receivedBytes; }
 	static inline char receiveBufferFull() { return getReceivedBytes() == ports[0].receiveSize; }
 	static inline unsigned char getMode() { return ports[0].mode; }
+	static inline void setReceiveHook(void (*hook)(unsigned char)) { receiveHooks[0] = hook; }
+	static FILE *initPrintf(char *buffer, unsigned char size, unsigned char policy = SERIAL_PRINTF_DROP);
+	static inline unsigned int getPrintfDropped() { return ports[0].droppedBytes; }
+	static void flushPrintf();
+	static void setFlowControl(unsigned char mode);
+	static void setFlowControlPins(unsigned char rts_pin, unsigned char cts_pin);
+	static void throttleReceive(unsigned char stop);
+	static inline char isSendStopped() { return flow[0].state & SERIAL_FLOW_TX_STOPPED; }
+	static void setFrameCallback(char *buffer, unsigned char size, unsigned int delimiter,
+		void (*callback)(char *frame, unsigned char length), unsigned char dispatch);
+	static inline unsigned int getFrameDroppedBytes() { return frames[0].droppedBytes; }
 #endif
 
+	static void dispatchCallbacks();
+
 #if _SERIAL_PORTS > 1
   public:
 #else
@@ -165,25 +322,54 @@ class OrangutanSerial
 	static _SINGLE_PORT_INLINE void cancelReceive(unsigned char port);
 	static _SINGLE_PORT_INLINE void send(unsigned char port, char *buffer, unsigned char size);
 	static _SINGLE_PORT_INLINE void sendBlocking(unsigned char port, char *buffer, unsigned char size);
-	static inline char sendBufferEmpty(unsigned char port) { return ports[port].sentBytes == ports[port].sendSize; }
+	static inline char sendBufferEmpty(unsigned char port) { return !sendPending(port); }
 	static inline unsigned char getMode(unsigned char port) { return ports[port].mode; }
 	static inline unsigned char getReceivedBytes(unsigned char port) { return ports[port].receivedBytes; }
 	static inline char receiveBufferFull(unsigned char port) { return getReceivedBytes(port) == ports[port].receiveSize; }
 	static inline unsigned char getSentBytes(unsigned char port) { return ports[port].sentBytes; }
+	static inline void setReceiveHook(unsigned char port, void (*hook)(unsigned char)) { receiveHooks[port] = hook; }
+	static _SINGLE_PORT_INLINE FILE *initPrintf(unsigned char port, char *buffer, unsigned char size, unsigned char policy = SERIAL_PRINTF_DROP);
+	static inline unsigned int getPrintfDropped(unsigned char port) { return ports[port].droppedBytes; }
+	static _SINGLE_PORT_INLINE void flushPrintf(unsigned char port);
+	static _SINGLE_PORT_INLINE void setFlowControl(unsigned char port, unsigned char mode);
+	static _SINGLE_PORT_INLINE void setFlowControlPins(unsigned char port, unsigned char rts_pin, unsigned char cts_pin);
+	static _SINGLE_PORT_INLINE void throttleReceive(unsigned char port, unsigned char stop);
+	static inline char isSendStopped(unsigned char port) { return flow[port].state & SERIAL_FLOW_TX_STOPPED; }
+	static _SINGLE_PORT_INLINE void setFrameCallback(unsigned char port, char *buffer, unsigned char size,
+		unsigned int delimiter, void (*callback)(char *frame, unsigned char length), unsigned char dispatch);
+	static inline unsigned int getFrameDroppedBytes(unsigned char port) { return frames[port].droppedBytes; }
 
   private:
 
 	static SerialPortData ports[_SERIAL_PORTS];
+	static void (* volatile receiveHooks[_SERIAL_PORTS])(unsigned char);
+	static SerialFlowData flow[_SERIAL_PORTS];
+	static SerialFrameData frames[_SERIAL_PORTS];
+
+	// True while there are bytes in the send buffer (or ring) that have
+	// not been sent.
+	static inline char sendPending(unsigned char port)
+	{
+		if (ports[port].sendRingOn)
+		{
+			return ports[port].sentBytes != ports[port].sendRingHead;
+		}
+		return ports[port].sendBuffer && ports[port].sentBytes < ports[port].sendSize;
+	}
 
 	static inline void initUART_inline(unsigned char port);
 	static inline void receive_inline(unsigned char port, char *buffer, unsigned char size, unsigned char ring);
 
 	static inline void uart_update_tx_interrupt(unsigned char port);
 	static inline void serial_tx_check(unsigned char port);
+	static inline void advanceSentBytes(unsigned char port);
+	static inline char flow_tx_stopped(unsigned char port);
+	static inline void flow_throttle(unsigned char port, unsigned char stop);
+	static void flowControlTick();
+	static inline void frame_handle_byte(unsigned char port, unsigned char byte_received);
+	static inline void frame_dispatch(unsigned char port);
 	static inline void serial_rx_check(unsigned char port);
 
-	static void initPort(unsigned char port);
-
 	// Don't call these functions.  They should only be called from the interrupt-service routine
 	// defined in OrangutanSerial.cpp.  They only reason they are public is because they need to
 	// access private data (ports) and David could not figure out how to make the ISR be inside the class.
@@ -192,11 +378,55 @@ class OrangutanSerial
 	static inline void serial_rx_handle_byte(unsigned char port, unsigned char byte_received);
 };
 
+// The functions of one serial port, selected at compile time.  For
+// example, SerialPort<UART1>::sendBlocking(buffer, size) does the same as
+// OrangutanSerial::sendBlocking(UART1, buffer, size), but without the
+// run-time port checks.  On single-port devices, only SerialPort<0> exists.
+template<unsigned char port> class SerialPort
+{
+  public:
+	static void setBaudRate(unsigned long baud);
+	static void setMode(unsigned char mode);
+	static void receive(char *buffer, unsigned char size);
+	static char receiveBlocking(char *buffer, unsigned char size, unsigned int timeout_ms);
+	static void receiveRing(char *buffer, unsigned char size);
+	static void cancelReceive();
+	static void send(char *buffer, unsigned char size);
+	static void sendBlocking(char *buffer, unsigned char size);
+	static inline char sendBufferEmpty() { return !OrangutanSerial::sendPending(port); }
+	static inline unsigned char getSentBytes() { return OrangutanSerial::ports[port].sentBytes; }
+	static inline unsigned char getReceivedBytes() { return OrangutanSerial::ports[port].receivedBytes; }
+	static inline char receiveBufferFull() { return getReceivedBytes() == OrangutanSerial::ports[port].receiveSize; }
+	static inline unsigned char getMode() { return OrangutanSerial::ports[port].mode; }
+	static inline void setReceiveHook(void (*hook)(unsigned char)) { OrangutanSerial::receiveHooks[port] = hook; }
+	static FILE *initPrintf(char *buffer, unsigned char size, unsigned char policy = SERIAL_PRINTF_DROP);
+	static inline unsigned int getPrintfDropped() { return OrangutanSerial::ports[port].droppedBytes; }
+	static void flushPrintf();
+	static void setFlowControl(unsigned char mode);
+	static void setFlowControlPins(unsigned char rts_pin, unsigned char cts_pin);
+	static void throttleReceive(unsigned char stop);
+	static inline char isSendStopped() { return OrangutanSerial::flow[port].state & SERIAL_FLOW_TX_STOPPED; }
+	static void setFrameCallback(char *buffer, unsigned char size, unsigned int delimiter,
+		void (*callback)(char *frame, unsigned char length), unsigned char dispatch);
+	static inline unsigned int getFrameDroppedBytes() { return OrangutanSerial::frames[port].droppedBytes; }
+
+	// The put function of the printf stream.  You should not need to
+	// call it directly.
+	static int printfPutChar(char c, FILE *f);
+
+  private:
+	static FILE stream;
+
+	// Called by the blocking functions while they wait.
+	static void idle();
+};
+
 extern "C" {
 #endif //__cplusplus
 
 // C Function declarations.
 void serial_check(void);
+void serial_dispatch_callbacks(void);
 
 #if _SERIAL_PORTS > 1
 void serial_set_baud_rate(unsigned char port, unsigned long baud);
@@ -212,6 +442,16 @@ void serial_send(unsigned char port, char *buffer, unsigned char size);
 void serial_send_blocking(unsigned char port, char *buffer, unsigned char size);
 unsigned char serial_get_sent_bytes(unsigned char port);
 char serial_send_buffer_empty(unsigned char port);
+FILE *serial_init_printf(unsigned char port, char *buffer, unsigned char size, unsigned char policy);
+unsigned int serial_get_printf_dropped(unsigned char port);
+void serial_flush_printf(unsigned char port);
+void serial_set_flow_control(unsigned char port, unsigned char mode);
+void serial_set_flow_control_pins(unsigned char port, unsigned char rts_pin, unsigned char cts_pin);
+void serial_throttle_receive(unsigned char port, unsigned char stop);
+char serial_is_send_stopped(unsigned char port);
+void serial_set_frame_callback(unsigned char port, char *buffer, unsigned char size, unsigned int delimiter,
+	void (*callback)(char *frame, unsigned char length), unsigned char dispatch);
+unsigned int serial_get_frame_dropped_bytes(unsigned char port);
 #else
 void serial_set_baud_rate(unsigned long baud);
 void serial_set_mode(unsigned char mode);
@@ -226,6 +466,16 @@ void serial_send(char *buffer, unsigned char size);
 void serial_send_blocking(char *buffer, unsigned char size);
 unsigned char serial_get_sent_bytes(void);
 char serial_send_buffer_empty(void);
+FILE *serial_init_printf(char *buffer, unsigned char size, unsigned char policy);
+unsigned int serial_get_printf_dropped(void);
+void serial_flush_printf(void);
+void serial_set_flow_control(unsigned char mode);
+void serial_set_flow_control_pins(unsigned char rts_pin, unsigned char cts_pin);
+void serial_throttle_receive(unsigned char stop);
+char serial_is_send_stopped(void);
+void serial_set_frame_callback(char *buffer, unsigned char size, unsigned int delimiter,
+	void (*callback)(char *frame, unsigned char length), unsigned char dispatch);
+unsigned int serial_get_frame_dropped_bytes(void);
 #endif
 
 #ifdef __cplusplus
@@ -0,0 +1,466 @@
+/*
+  OrangutanSerialBus.cpp - Addressed, CRC-checked frames on a shared
+      half-duplex serial bus (e.g. RS-485), with master polling.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef F_CPU
+#define F_CPU 20000000UL
+#endif
+
+#include "OrangutanSerialBus.h"
+#include "../OrangutanDigital/OrangutanDigital.h"
+#include "../OrangutanTime/OrangutanTime.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/crc16.h>
+
+#define FRAME_START	0x7E
+
+// frame types
+#define FRAME_POLL	1	// master to slave, must be answered
+#define FRAME_REPLY	2	// slave to master
+#define FRAME_DATA	3	// master to one or all slaves, not answered
+
+unsigned char OrangutanSerialBus::address;
+volatile unsigned char *OrangutanSerialBus::dePortRegister;
+unsigned char OrangutanSerialBus::deMask;
+unsigned char OrangutanSerialBus::replyTimeout = 5;
+unsigned char OrangutanSerialBus::headerTime;
+unsigned char OrangutanSerialBus::replyDelay;
+
+unsigned char OrangutanSerialBus::txHeader[5];
+char *OrangutanSerialBus::txData;
+unsigned char OrangutanSerialBus::txCrc[2];
+unsigned char OrangutanSerialBus::txIndex;
+volatile unsigned char OrangutanSerialBus::txActive;
+
+unsigned char OrangutanSerialBus::rxIndex;
+unsigned char OrangutanSerialBus::rxHeader[5];
+unsigned int OrangutanSerialBus::rxCrc;
+unsigned char OrangutanSerialBus::rxTime;
+unsigned char OrangutanSerialBus::rxAccept;
+char *OrangutanSerialBus::receiveBuffer;
+unsigned char OrangutanSerialBus::receiveSize;
+volatile unsigned char OrangutanSerialBus::receivedBytes;
+volatile unsigned char OrangutanSerialBus::receivedSource = OrangutanSerialBus::NO_FRAME;
+
+char * volatile OrangutanSerialBus::replyBuffer;
+unsigned char OrangutanSerialBus::replySize;
+
+volatile unsigned char OrangutanSerialBus::status = SERIAL_BUS_IDLE;
+unsigned char OrangutanSerialBus::polledAddress;
+volatile unsigned char OrangutanSerialBus::pollEndTime;
+volatile unsigned char OrangutanSerialBus::replyStarted;
+
+volatile unsigned int OrangutanSerialBus::frameCount;
+volatile unsigned int OrangutanSerialBus::errorCount;
+
+extern "C" void serial_bus_init(unsigned char address, unsigned long baud, unsigned char de_pin)
+{
+	OrangutanSerialBus::init(address, baud, de_pin);
+}
+
+extern "C" void serial_bus_set_reply_timeout(unsigned char timeout_ms)
+{
+	OrangutanSerialBus::setReplyTimeout(timeout_ms);
+}
+
+extern "C" void serial_bus_receive(char *buffer, unsigned char size)
+{
+	OrangutanSerialBus::receive(buffer, size);
+}
+
+extern "C" unsigned char serial_bus_frame_received()
+{
+	return OrangutanSerialBus::frameReceived();
+}
+
+extern "C" unsigned char serial_bus_get_received_bytes()
+{
+	return OrangutanSerialBus::getReceivedBytes();
+}
+
+extern "C" unsigned char serial_bus_get_received_source()
+{
+	return OrangutanSerialBus::getReceivedSource();
+}
+
+extern "C" void serial_bus_set_reply(char *buffer, unsigned char size)
+{
+	OrangutanSerialBus::setReply(buffer, size);
+}
+
+extern "C" unsigned char serial_bus_reply_sent()
+{
+	return OrangutanSerialBus::replySent();
+}
+
+extern "C" void serial_bus_poll(unsigned char address, char *data, unsigned char size)
+{
+	OrangutanSerialBus::poll(address, data, size);
+}
+
+extern "C" unsigned char serial_bus_poll_blocking(unsigned char address, char *data, unsigned char size)
+{
+	return OrangutanSerialBus::pollBlocking(address, data, size);
+}
+
+extern "C" void serial_bus_send(unsigned char address, char *data, unsigned char size)
+{
+	OrangutanSerialBus::send(address, data, size);
+}
+
+extern "C" unsigned char serial_bus_get_status()
+{
+	return OrangutanSerialBus::getStatus();
+}
+
+extern "C" unsigned int serial_bus_get_frame_count()
+{
+	return OrangutanSerialBus::getFrameCount();
+}
+
+extern "C" unsigned int serial_bus_get_error_count()
+{
+	return OrangutanSerialBus::getErrorCount();
+}
+
+#ifdef USART_TX_vect
+ISR(USART_TX_vect)
+{
+	OrangutanSerialBus::transmitInterrupt();
+}
+#endif
+
+#ifdef USART0_TX_vect
+ISR(USART0_TX_vect)
+{
+	OrangutanSerialBus::transmitInterrupt();
+}
+#endif
+
+OrangutanSerialBus::OrangutanSerialBus()
+{
+}
+
+void OrangutanSerialBus::init(unsigned char address, unsigned long baud, unsigned char de_pin)
+{
+	OrangutanSerialBus::address = address;
+
+	dePortRegister = 0;
+	if (de_pin != SERIAL_BUS_NO_PIN)
+	{
+		struct IOStruct io;
+		OrangutanDigital::setOutput(de_pin, LOW);	// start out listening
+		OrangutanDigital::getIORegisters(&io, de_pin);
+		dePortRegister = io.portRegister;
+		deMask = io.bitmask;
+	}
+
+	// A slave waits a little over one bit time before answering, because
+	// its RX interrupt runs in the middle of the master's last stop bit,
+	// before the master has let go of the bus.
+	unsigned long delay = 1000000 / baud + 2;
+	replyDelay = delay > 255 ? 255 : delay;
+
+	// 5 bytes of 10 bits each, plus 1 ms for the granularity of ms()
+	unsigned long header = (50000 + baud - 1) / baud + 1;
+	headerTime = header > 100 ? 100 : header;
+
+	SerialPort<0>::setMode(SERIAL_AUTOMATIC);
+	SerialPort<0>::setBaudRate(baud);
+	SerialPort<0>::setReceiveHook(receiveByte);
+}
+
+void OrangutanSerialBus::setReplyTimeout(unsigned char timeout_ms)
+{
+	replyTimeout = timeout_ms;
+}
+
+void OrangutanSerialBus::receive(char *buffer, unsigned char size)
+{
+	unsigned char sreg = SREG;
+	cli();
+	receiveBuffer = buffer;
+	receiveSize = size;
+	receivedBytes = 0;
+	receivedSource = NO_FRAME;
+	SREG = sreg;
+}
+
+void OrangutanSerialBus::setReply(char *buffer, unsigned char size)
+{
+	unsigned char sreg = SREG;
+	cli();
+	replySize = size;
+	replyBuffer = buffer;
+	SREG = sreg;
+}
+
+/** SENDING *******************************************************************/
+
+// Starts sending a frame.  Call with interrupts disabled.
+void OrangutanSerialBus::startFrame(unsigned char destination, unsigned char type, char *data, unsigned char size)
+{
+	txHeader[0] = FRAME_START;
+	txHeader[1] = destination;
+	txHeader[2] = address;
+	txHeader[3] = type;
+	txHeader[4] = size;
+	txData = data;
+
+	unsigned int crc = 0xFFFF;
+	for (unsigned char i = 1; i < 5; i++)
+		crc = _crc_xmodem_update(crc, txHeader[i]);
+	for (unsigned char i = 0; i < size; i++)
+		crc = _crc_xmodem_update(crc, data[i]);
+	txCrc[0] = crc >> 8;
+	txCrc[1] = crc;
+
+	txIndex = 0;
+	txActive = 1;
+	if (dePortRegister)
+		*dePortRegister |= deMask;
+
+	// Clear any old TX complete flag, then load the first bytes.  The
+	// TX complete interrupt happens when they are all out.
+	UCSR0A |= 1 << TXC0;
+	UCSR0B |= 1 << TXCIE0;
+	transmitInterrupt();
+}
+
+// Loads as many bytes as the UART can take (two when it is idle: one in
+// the shift register and one in UDR0), or finishes the frame if they
+// have all been sent.
+inline void OrangutanSerialBus::transmitInterrupt()
+{
+	unsigned char size = txHeader[4];
+	unsigned char total = size + 7;
+
+	if (txIndex == total)
+	{
+		// The last stop bit is done, so let go of the bus.
+		if (dePortRegister)
+			*dePortRegister &= ~deMask;
+		UCSR0B &= ~(1 << TXCIE0);
+		txActive = 0;
+
+		if (txHeader[3] == FRAME_POLL)
+			pollEndTime = OrangutanTime::ms();
+		else if (txHeader[3] == FRAME_REPLY && replyBuffer == txData)
+			replyBuffer = 0;	// not if a new reply was set while sending an empty one
+		else
+			status = SERIAL_BUS_IDLE;
+		return;
+	}
+
+	while (txIndex < total && (UCSR0A & (1 << UDRE0)))
+	{
+		unsigned char i = txIndex;
+		if (i < 5)
+			UDR0 = txHeader[i];
+		else if (i < 5 + size)
+			UDR0 = txData[i - 5];
+		else
+			UDR0 = txCrc[i - 5 - size];
+		txIndex = i + 1;
+	}
+}
+
+void OrangutanSerialBus::poll(unsigned char address, char *data, unsigned char size)
+{
+	unsigned char sreg = SREG;
+	cli();
+	polledAddress = address;
+	replyStarted = 0;
+	status = SERIAL_BUS_BUSY;
+	startFrame(address, FRAME_POLL, data, size);
+	SREG = sreg;
+}
+
+unsigned char OrangutanSerialBus::pollBlocking(unsigned char address, char *data, unsigned char size)
+{
+	poll(address, data, size);
+
+	unsigned char result;
+	while ((result = getStatus()) == SERIAL_BUS_BUSY)
+		OrangutanTime::idle();
+	return result;
+}
+
+void OrangutanSerialBus::send(unsigned char address, char *data, unsigned char size)
+{
+	unsigned char sreg = SREG;
+	cli();
+	status = SERIAL_BUS_BUSY;
+	startFrame(address, FRAME_DATA, data, size);
+	SREG = sreg;
+}
+
+unsigned char OrangutanSerialBus::getStatus()
+{
+	unsigned char sreg = SREG;
+	cli();
+	if (status == SERIAL_BUS_BUSY && !txActive && txHeader[3] == FRAME_POLL)
+	{
+		unsigned char now = OrangutanTime::ms();
+		if (replyStarted)
+		{
+			// The reply is arriving; it has only failed if it stopped.
+			if ((unsigned char)(now - rxTime) > SERIAL_BUS_FRAME_GAP_MS)
+				status = SERIAL_BUS_TIMEOUT;
+		}
+		else if ((unsigned char)(now - pollEndTime) > (unsigned char)(replyTimeout + headerTime))
+		{
+			status = SERIAL_BUS_TIMEOUT;
+		}
+	}
+	SREG = sreg;
+	return status;
+}
+
+/** RECEIVING *****************************************************************/
+
+// Called when a frame with a good CRC has been received.
+inline void OrangutanSerialBus::frameDone()
+{
+	frameCount++;
+
+	if (rxAccept & 1)
+	{
+		unsigned char length = rxHeader[4];
+		receivedBytes = length < receiveSize ? length : receiveSize;
+		receivedSource = rxHeader[2];
+
+		if (rxHeader[3] == FRAME_REPLY && status == SERIAL_BUS_BUSY)
+			status = SERIAL_BUS_DONE;
+	}
+	if (rxHeader[3] == FRAME_REPLY)
+		replyStarted = 0;
+
+	if (rxAccept & 2)
+	{
+		OrangutanTime::delayMicroseconds(replyDelay);
+		char *data = replyBuffer;
+		startFrame(rxHeader[2], FRAME_REPLY, data, data ? replySize : 0);
+	}
+}
+
+// Drops the frame being received.  If it was the reply to our poll, the
+// poll has failed.
+inline void OrangutanSerialBus::receiveError()
+{
+	errorCount++;
+	rxIndex = 0;
+	if (replyStarted)
+	{
+		replyStarted = 0;
+		if (status == SERIAL_BUS_BUSY)
+			status = SERIAL_BUS_TIMEOUT;
+	}
+}
+
+// The receive hook.  This runs in the UART RX interrupt for every byte.
+void OrangutanSerialBus::receiveByte(unsigned char byte)
+{
+	if (txActive)
+		return;		// we are hearing ourselves
+
+	unsigned char now = OrangutanTime::ms();
+	if (rxIndex && (unsigned char)(now - rxTime) > SERIAL_BUS_FRAME_GAP_MS)
+		receiveError();
+	rxTime = now;
+
+	if (rxIndex == 0)
+	{
+		if (byte == FRAME_START)
+		{
+			rxCrc = 0xFFFF;
+			rxIndex = 1;
+		}
+		return;
+	}
+
+	rxCrc = _crc_xmodem_update(rxCrc, byte);
+
+	if (rxIndex < 5)
+	{
+		// header: destination, source, type, length
+		rxHeader[rxIndex] = byte;
+		if (rxIndex == 4)
+		{
+			if (byte > SERIAL_BUS_MAX_DATA)
+			{
+				errorCount++;
+				rxIndex = 0;
+				return;
+			}
+
+			// Decide now whether the data goes into the receive buffer.
+			unsigned char destination = rxHeader[1];
+			rxAccept = (destination == address || destination == SERIAL_BUS_BROADCAST) &&
+				receiveBuffer && receivedSource == NO_FRAME;
+			if (rxHeader[3] == FRAME_REPLY && (status != SERIAL_BUS_BUSY || rxHeader[2] != polledAddress))
+				rxAccept = 0;	// a reply nobody is waiting for
+			else if (rxHeader[3] == FRAME_REPLY && destination == address)
+				replyStarted = 1;	// the reply timeout no longer applies
+			if (rxHeader[3] == FRAME_POLL && destination == address)
+				rxAccept |= 2;	// answer it even if its data is not wanted
+		}
+		rxIndex++;
+		return;
+	}
+
+	unsigned char i = rxIndex - 5;
+	unsigned char length = rxHeader[4];
+	if (i < length)
+	{
+		if ((rxAccept & 1) && i < receiveSize)
+			receiveBuffer[i] = byte;
+		rxIndex++;
+	}
+	else if (i == length)
+	{
+		rxIndex++;	// CRC high byte
+	}
+	else
+	{
+		// CRC low byte: running the CRC over the received CRC leaves 0.
+		if (rxCrc)
+			receiveError();
+		else
+		{
+			rxIndex = 0;
+			frameDone();
+		}
+	}
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
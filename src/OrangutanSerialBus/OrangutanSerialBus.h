@@ -0,0 +1,226 @@
+/*
+  OrangutanSerialBus.h - Addressed, CRC-checked frames on a shared
+      half-duplex serial bus (e.g. RS-485), with master polling.
+ */
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+
+#ifndef OrangutanSerialBus_h
+#define OrangutanSerialBus_h
+
+#include "../OrangutanSerial/OrangutanSerial.h"
+
+// The largest payload a frame can carry.
+#define SERIAL_BUS_MAX_DATA		32
+
+// Frames sent to this address are accepted by every node and never
+// answered.
+#define SERIAL_BUS_BROADCAST	0xFF
+
+// A pause longer than this inside a frame means the frame was cut short.
+#define SERIAL_BUS_FRAME_GAP_MS	2
+
+// Pass this to init() if there is no transceiver driver-enable pin.
+#define SERIAL_BUS_NO_PIN		0xFF
+
+// Values returned by getStatus().
+#define SERIAL_BUS_IDLE			0	// nothing has been polled yet
+#define SERIAL_BUS_BUSY			1	// sending a poll or waiting for the reply
+#define SERIAL_BUS_DONE			2	// the reply is in the receive buffer
+#define SERIAL_BUS_TIMEOUT		3	// the polled node did not start answering in time, or its reply was cut short or corrupted
+
+#ifdef __cplusplus
+
+// OrangutanSerialBus lets many Orangutans and 3pis share one half-duplex
+// serial line.  Every node has an address from 0 to 254.  One node, the
+// master, owns the bus: it sends a poll frame to one node at a time, and
+// that node answers right away with a reply frame, so two nodes never
+// talk at once.  A poll frame can carry data to the node and a reply can
+// carry data back.  Frames to SERIAL_BUS_BROADCAST are not answered.
+//
+// A frame on the wire is:
+//
+//   0x7E, destination, source, type, length, data..., CRC high, CRC low
+//
+// where the CRC is the CRC-16-CCITT (polynomial 0x1021, initial value
+// 0xFFFF) of everything after the 0x7E.  Frames with a bad CRC are
+// dropped and counted, and a gap of more than SERIAL_BUS_FRAME_GAP_MS
+// inside a frame makes the receiver look for a new one.
+//
+// The bus uses UART0 (the only UART on the 3pi, Baby Orangutan and
+// Orangutan SV/LV).  Received bytes are handled by a receive hook in the
+// OrangutanSerial RX interrupt and frames are sent from the USART
+// TX-complete interrupt, so the serial port must be in SERIAL_AUTOMATIC
+// mode and should not be used for anything else.  The driver-enable pin
+// of an RS-485 transceiver is driven high for exactly as long as the node
+// is transmitting.  Bytes the node hears from itself while transmitting
+// are ignored, so the receiver can be left enabled.
+class OrangutanSerialBus
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	OrangutanSerialBus();
+
+	// Sets this node's address and the baud rate and starts listening.
+	// de_pin is the transceiver's driver-enable pin (one of the IO_*
+	// pins in OrangutanDigital.h) or SERIAL_BUS_NO_PIN.
+	static void init(unsigned char address, unsigned long baud, unsigned char de_pin);
+
+	// Sets how long the master waits for a reply to start after the end
+	// of its poll frame.  The default is 5 ms.  The time it takes to
+	// receive the 5-byte reply header at the baud rate given to init()
+	// is added to this, and once a reply header addressed to the master
+	// has arrived the timeout no longer applies: the reply only fails
+	// if it has a bad CRC or a gap of more than SERIAL_BUS_FRAME_GAP_MS,
+	// so long replies at low baud rates are not cut off.
+	static void setReplyTimeout(unsigned char timeout_ms);
+
+	// Sets up a buffer for the data of the next frame addressed to this
+	// node: a poll if this node is a slave, or a reply if it is the
+	// master.  One frame is stored; frames that arrive after that are
+	// dropped until receive() is called again.  Data that does not fit
+	// in the buffer is discarded.
+	static void receive(char *buffer, unsigned char size);
+
+	// True once a frame has been stored in the receive buffer.
+	static inline unsigned char frameReceived() { return receivedSource != NO_FRAME; }
+
+	// The number of data bytes and the sender of the stored frame.
+	static inline unsigned char getReceivedBytes() { return receivedBytes; }
+	static inline unsigned char getReceivedSource() { return receivedSource; }
+
+	// Slaves: sets the data sent in the reply to the next poll.  The
+	// buffer must not be changed until replySent() returns true.  If no
+	// reply data is set, the node answers polls with an empty reply.
+	static void setReply(char *buffer, unsigned char size);
+	static inline unsigned char replySent() { return replyBuffer == 0; }
+
+	// Master: sends a poll frame with the given data to a node and
+	// starts waiting for its reply.  Call receive() first to say where
+	// the reply data should go.  Use getStatus() to find out when it is
+	// done.  poll() must not be called while the status is
+	// SERIAL_BUS_BUSY.
+	static void poll(unsigned char address, char *data, unsigned char size);
+
+	// Master: same as poll(), but waits for the reply or the timeout and
+	// returns the final status.
+	static unsigned char pollBlocking(unsigned char address, char *data, unsigned char size);
+
+	// Master: sends data that no node answers, usually to
+	// SERIAL_BUS_BROADCAST.  The status is SERIAL_BUS_BUSY while the frame
+	// is being sent, then SERIAL_BUS_IDLE.
+	static void send(unsigned char address, char *data, unsigned char size);
+
+	// Returns one of the SERIAL_BUS_* status values above.
+	static unsigned char getStatus();
+
+	// The number of good frames seen on the bus (including frames for
+	// other nodes) and the number dropped because of a bad CRC, a bad
+	// length or a gap.
+	static inline unsigned int getFrameCount() { return frameCount; }
+	static inline unsigned int getErrorCount() { return errorCount; }
+
+	// Don't call these functions.  They are only public because the
+	// serial interrupts need them.
+	static void receiveByte(unsigned char byte);
+	static inline void transmitInterrupt();
+
+  private:
+
+	enum { NO_FRAME = 0xFF };
+
+	static void startFrame(unsigned char address, unsigned char type, char *data, unsigned char size);
+	static inline void frameDone();
+
+	static unsigned char address;
+	static volatile unsigned char *dePortRegister;	// 0 if there is no DE pin
+	static unsigned char deMask;
+	static unsigned char replyTimeout;
+	static unsigned char headerTime;	// ms to receive a frame header, rounded up
+	static unsigned char replyDelay;	// turnaround time in microseconds
+
+	// transmitting
+	static unsigned char txHeader[5];
+	static char *txData;
+	static unsigned char txCrc[2];
+	static unsigned char txIndex;
+	static volatile unsigned char txActive;
+
+	// receiving
+	static unsigned char rxIndex;
+	static unsigned char rxHeader[5];
+	static unsigned int rxCrc;
+	static unsigned char rxTime;		// low byte of ms() when the last byte came
+	static unsigned char rxAccept;		// bit 0: store the data, bit 1: answer the poll
+	static char *receiveBuffer;
+	static unsigned char receiveSize;
+	static volatile unsigned char receivedBytes;
+	static volatile unsigned char receivedSource;
+
+	// slave replies
+	static char * volatile replyBuffer;
+	static unsigned char replySize;
+
+	// master polls
+	static volatile unsigned char status;
+	static unsigned char polledAddress;
+	static volatile unsigned char pollEndTime;
+	static volatile unsigned char replyStarted;	// a reply header for the poll has arrived
+
+	static inline void receiveError();
+
+	static volatile unsigned int frameCount;
+	static volatile unsigned int errorCount;
+};
+
+extern "C" {
+#endif // __cplusplus
+
+void serial_bus_init(unsigned char address, unsigned long baud, unsigned char de_pin);
+void serial_bus_set_reply_timeout(unsigned char timeout_ms);
+void serial_bus_receive(char *buffer, unsigned char size);
+unsigned char serial_bus_frame_received(void);
+unsigned char serial_bus_get_received_bytes(void);
+unsigned char serial_bus_get_received_source(void);
+void serial_bus_set_reply(char *buffer, unsigned char size);
+unsigned char serial_bus_reply_sent(void);
+void serial_bus_poll(unsigned char address, char *data, unsigned char size);
+unsigned char serial_bus_poll_blocking(unsigned char address, char *data, unsigned char size);
+void serial_bus_send(unsigned char address, char *data, unsigned char size);
+unsigned char serial_bus_get_status(void);
+unsigned int serial_bus_get_frame_count(void);
+unsigned int serial_bus_get_error_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,470 @@
+/*
+  OrangutanSoftSerial.cpp - Software UART ports on arbitrary I/O pins, timed
+      with Timer1 compare match B, with the same buffer-based interface as
+      OrangutanSerial.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef F_CPU
+#define F_CPU 20000000UL
+#endif
+
+#include "OrangutanSoftSerial.h"
+#include "../OrangutanDigital/OrangutanDigital.h"
+#include "../OrangutanTime/OrangutanTime.h"
+#include "../OrangutanResources/include/OrangutanModel.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+#define TIMER1_FREQUENCY	(F_CPU / 8)
+
+// Timer1 ticks between a start bit's falling edge and the moment the
+// pin-change interrupt reads TCNT1.
+#define PIN_CHANGE_LATENCY	4
+
+SerialPortData OrangutanSoftSerial::ports[SOFT_SERIAL_PORTS];
+SoftSerialPortState OrangutanSoftSerial::state[SOFT_SERIAL_PORTS];
+
+extern "C" void soft_serial_init(unsigned char port, unsigned char rx_pin, unsigned char tx_pin)
+{
+	OrangutanSoftSerial::init(port, rx_pin, tx_pin);
+}
+
+extern "C" void soft_serial_set_baud_rate(unsigned char port, unsigned long baud)
+{
+	OrangutanSoftSerial::setBaudRate(port, baud);
+}
+
+extern "C" void soft_serial_receive(unsigned char port, char *buffer, unsigned char size)
+{
+	OrangutanSoftSerial::receive(port, buffer, size);
+}
+
+extern "C" char soft_serial_receive_blocking(unsigned char port, char *buffer, unsigned char size, unsigned int timeout_ms)
+{
+	return OrangutanSoftSerial::receiveBlocking(port, buffer, size, timeout_ms);
+}
+
+extern "C" void soft_serial_receive_ring(unsigned char port, char *buffer, unsigned char size)
+{
+	OrangutanSoftSerial::receiveRing(port, buffer, size);
+}
+
+extern "C" void soft_serial_cancel_receive(unsigned char port)
+{
+	OrangutanSoftSerial::cancelReceive(port);
+}
+
+extern "C" unsigned char soft_serial_get_received_bytes(unsigned char port)
+{
+	return OrangutanSoftSerial::getReceivedBytes(port);
+}
+
+extern "C" char soft_serial_receive_buffer_full(unsigned char port)
+{
+	return OrangutanSoftSerial::receiveBufferFull(port);
+}
+
+extern "C" void soft_serial_send(unsigned char port, char *buffer, unsigned char size)
+{
+	OrangutanSoftSerial::send(port, buffer, size);
+}
+
+extern "C" void soft_serial_send_blocking(unsigned char port, char *buffer, unsigned char size)
+{
+	OrangutanSoftSerial::sendBlocking(port, buffer, size);
+}
+
+extern "C" unsigned char soft_serial_get_sent_bytes(unsigned char port)
+{
+	return OrangutanSoftSerial::getSentBytes(port);
+}
+
+extern "C" char soft_serial_send_buffer_empty(unsigned char port)
+{
+	return OrangutanSoftSerial::sendBufferEmpty(port);
+}
+
+ISR(TIMER1_COMPB_vect)
+{
+	OrangutanSoftSerial::timerInterrupt();
+}
+
+ISR(PCINT0_vect)
+{
+	OrangutanSoftSerial::pinChangeInterrupt();
+}
+
+ISR(PCINT1_vect,ISR_ALIASOF(PCINT0_vect));
+ISR(PCINT2_vect,ISR_ALIASOF(PCINT0_vect));
+#ifdef PCINT3_vect
+ISR(PCINT3_vect,ISR_ALIASOF(PCINT0_vect));
+#endif
+
+// Makes the timer interrupt run a few microseconds from now, so that it
+// can look at the new state and schedule the next bit.  Call with
+// interrupts disabled.
+static inline void kickTimer()
+{
+	OCR1B = TCNT1 + 8;
+	TIFR1 = 1 << OCF1B;
+	TIMSK1 |= 1 << OCIE1B;
+}
+
+OrangutanSoftSerial::OrangutanSoftSerial()
+{
+}
+
+void OrangutanSoftSerial::init(unsigned char port, unsigned char rx_pin, unsigned char tx_pin)
+{
+	SoftSerialPortState *s = &state[port];
+	struct IOStruct io;
+
+	cli();
+
+	if (s->rxPinRegister)
+		*s->rxPCMSK &= ~s->rxMask;	// stop listening on the old pin
+	s->rxPinRegister = 0;
+	s->txPortRegister = 0;
+	s->rxBit = 0;
+	s->txBit = 0;
+
+	if (tx_pin != SOFT_SERIAL_NO_PIN)
+	{
+		OrangutanDigital::setOutput(tx_pin, HIGH);	// idle
+		OrangutanDigital::getIORegisters(&io, tx_pin);
+		s->txPortRegister = io.portRegister;
+		s->txMask = io.bitmask;
+	}
+
+	if (rx_pin != SOFT_SERIAL_NO_PIN)
+	{
+		OrangutanDigital::setInput(rx_pin, PULL_UP_ENABLED);
+		OrangutanDigital::getIORegisters(&io, rx_pin);
+		s->rxPinRegister = io.pinRegister;
+		s->rxMask = io.bitmask;
+
+#if defined(_ORANGUTAN_SVP) || defined(_ORANGUTAN_X2)
+		if (io.pinRegister == &PINA)
+			s->rxPCMSK = &PCMSK0;
+		else if (io.pinRegister == &PINB)
+			s->rxPCMSK = &PCMSK1;
+		else if (io.pinRegister == &PINC)
+			s->rxPCMSK = &PCMSK2;
+		else
+			s->rxPCMSK = &PCMSK3;
+#else
+		if (io.pinRegister == &PINB)
+			s->rxPCMSK = &PCMSK0;
+		else if (io.pinRegister == &PINC)
+			s->rxPCMSK = &PCMSK1;
+		else
+			s->rxPCMSK = &PCMSK2;
+#endif
+		s->rxIdle = (*s->rxPinRegister & s->rxMask) ? 1 : 0;
+		*s->rxPCMSK |= s->rxMask;
+		PCICR = 0xFF;	// as in PololuWheelEncoders, the PCMSKx bits control everything
+	}
+
+	if (s->bitTicks == 0)
+		s->bitTicks = TIMER1_FREQUENCY / 9600;
+
+	// Timer1: normal mode (counts freely from 0 to 0xFFFF), clock/8
+	TCCR1A = 0;
+	TCCR1B = 1 << CS11;
+
+	sei();
+}
+
+void OrangutanSoftSerial::setBaudRate(unsigned char port, unsigned long baud)
+{
+	state[port].bitTicks = (TIMER1_FREQUENCY + baud / 2) / baud;
+}
+
+/** RECEIVING *****************************************************************/
+
+// Samples one data bit, and stores the byte when all eight are in.
+// Then samples the stop bit before watching for the next start bit.
+inline void OrangutanSoftSerial::receiveBit(unsigned char port)
+{
+	SoftSerialPortState *s = &state[port];
+	unsigned char high = *s->rxPinRegister & s->rxMask;
+
+	if (s->rxBit == 9)
+	{
+		// The middle of the stop bit.  Only now can the line be relied
+		// on to be high; re-arming earlier (in the middle of the last
+		// data bit, which is low for any byte below 0x80) would let a pin
+		// change on another port in the same bank start a phantom byte.
+		// If the stop bit is low (a framing error or a break), the line
+		// must go high again before a start bit is accepted.
+		s->rxBit = 0;
+		s->rxIdle = high ? 1 : 0;
+		*s->rxPCMSK |= s->rxMask;
+		return;
+	}
+
+	s->rxByte >>= 1;
+	if (high)
+		s->rxByte |= 0x80;
+
+	s->rxBit++;
+	s->rxTime += s->bitTicks;
+	if (s->rxBit <= 8)
+		return;
+
+	// All eight data bits are in; store the byte now and sample the stop
+	// bit (rxBit 9) one bit later.
+	SerialPortData *p = &ports[port];
+	if (p->receiveBuffer && p->receivedBytes < p->receiveSize)
+	{
+		p->receiveBuffer[p->receivedBytes] = s->rxByte;
+		p->receivedBytes++;
+	}
+	if (p->receivedBytes == p->receiveSize && p->receiveRingOn)
+	{
+		p->receivedBytes = 0;	// reset the ring
+	}
+}
+
+inline void OrangutanSoftSerial::pinChangeInterrupt()
+{
+	unsigned int now = TCNT1;
+	unsigned char started = 0;
+
+	for (unsigned char port = 0; port < SOFT_SERIAL_PORTS; port++)
+	{
+		SoftSerialPortState *s = &state[port];
+
+		if (!s->rxPinRegister || s->rxBit || !(*s->rxPCMSK & s->rxMask))
+			continue;
+
+		// A start bit is a high-to-low transition: the pin must be low
+		// now and must have been seen high since the last byte.  Other
+		// pins in the same bank cause interrupts too, so a low pin alone
+		// is not enough.
+		if (*s->rxPinRegister & s->rxMask)
+		{
+			s->rxIdle = 1;
+			continue;
+		}
+		if (!s->rxIdle)
+			continue;
+		s->rxIdle = 0;
+
+		// Sample in the middle of each data bit, starting one and a half
+		// bits after the edge, and ignore edges until the byte is done.
+		*s->rxPCMSK &= ~s->rxMask;
+		s->rxBit = 1;
+		s->rxTime = now - PIN_CHANGE_LATENCY + s->bitTicks + s->bitTicks / 2;
+		started = 1;
+	}
+
+	if (started)
+		kickTimer();
+}
+
+void OrangutanSoftSerial::receive_inline(unsigned char port, char *buffer, unsigned char size, unsigned char ring)
+{
+	unsigned char sreg = SREG;
+	cli();
+	ports[port].receiveBuffer = buffer;
+	ports[port].receivedBytes = 0;
+	ports[port].receiveSize = size;
+	ports[port].receiveRingOn = ring;
+	SREG = sreg;
+}
+
+void OrangutanSoftSerial::receive(unsigned char port, char *buffer, unsigned char size)
+{
+	receive_inline(port, buffer, size, 0);
+}
+
+void OrangutanSoftSerial::receiveRing(unsigned char port, char *buffer, unsigned char size)
+{
+	receive_inline(port, buffer, size, 1);
+}
+
+char OrangutanSoftSerial::receiveBlocking(unsigned char port, char *buffer, unsigned char size, unsigned int timeout_ms)
+{
+	receive(port, buffer, size);
+
+	unsigned long start_time = OrangutanTime::ms();
+
+	while (1)
+	{
+		if (receiveBufferFull(port))
+			return 0; // Success
+
+		if (OrangutanTime::ms() - start_time >= timeout_ms)
+			return 1; // Timeout
+
+		OrangutanTime::idle();
+	}
+}
+
+/** SENDING *******************************************************************/
+
+// Outputs the next bit of the byte being sent.
+inline void OrangutanSoftSerial::sendBit(unsigned char port)
+{
+	SoftSerialPortState *s = &state[port];
+
+	if (s->txBit <= 8)
+	{
+		// data bits, least significant first
+		if (s->txByte & 1)
+			*s->txPortRegister |= s->txMask;
+		else
+			*s->txPortRegister &= ~s->txMask;
+		s->txByte >>= 1;
+	}
+	else if (s->txBit == 9)
+	{
+		*s->txPortRegister |= s->txMask;	// stop bit
+	}
+	else
+	{
+		// The stop bit is over; go straight on to the next byte.
+		s->txBit = 0;
+		SerialPortData *p = &ports[port];
+		if (p->sendBuffer && p->sentBytes < p->sendSize)
+		{
+			s->txByte = p->sendBuffer[p->sentBytes];
+			p->sentBytes++;	// we started sending a byte
+			*s->txPortRegister &= ~s->txMask;	// start bit
+			s->txBit = 1;
+			s->txTime += s->bitTicks;
+		}
+		return;
+	}
+
+	s->txBit++;
+	s->txTime += s->bitTicks;
+}
+
+void OrangutanSoftSerial::startSending(unsigned char port)
+{
+	SoftSerialPortState *s = &state[port];
+	SerialPortData *p = &ports[port];
+
+	unsigned char sreg = SREG;
+	cli();
+	if (s->txPortRegister && s->txBit == 0 && p->sendBuffer && p->sentBytes < p->sendSize)
+	{
+		s->txByte = p->sendBuffer[p->sentBytes];
+		p->sentBytes++;
+		*s->txPortRegister &= ~s->txMask;	// start bit
+		s->txTime = TCNT1 + s->bitTicks;
+		s->txBit = 1;
+		kickTimer();
+	}
+	SREG = sreg;
+}
+
+void OrangutanSoftSerial::send(unsigned char port, char *buffer, unsigned char size)
+{
+	unsigned char sreg = SREG;
+	cli();
+	ports[port].sendBuffer = buffer;
+	ports[port].sentBytes = 0;
+	ports[port].sendSize = size;
+	SREG = sreg;
+
+	// If a byte is already being sent, the timer interrupt continues
+	// with this buffer when it is done.
+	startSending(port);
+}
+
+void OrangutanSoftSerial::sendBlocking(unsigned char port, char *buffer, unsigned char size)
+{
+	send(port, buffer, size);
+
+	// wait for sending before returning
+	while (!sendBufferEmpty(port))
+		OrangutanTime::idle();
+}
+
+/** TIMING ********************************************************************/
+
+inline void OrangutanSoftSerial::timerInterrupt()
+{
+	while (1)
+	{
+		unsigned int now = TCNT1;
+		unsigned char active = 0;
+		int soonest = 0x7FFF;
+
+		// Handle every bit that is due, and find the next one.
+		for (unsigned char port = 0; port < SOFT_SERIAL_PORTS; port++)
+		{
+			SoftSerialPortState *s = &state[port];
+
+			if (s->rxBit)
+			{
+				if ((int)(s->rxTime - now) <= 0)
+					receiveBit(port);
+				if (s->rxBit)
+				{
+					active = 1;
+					if ((int)(s->rxTime - now) < soonest)
+						soonest = s->rxTime - now;
+				}
+			}
+
+			if (s->txBit)
+			{
+				if ((int)(s->txTime - now) <= 0)
+					sendBit(port);
+				if (s->txBit)
+				{
+					active = 1;
+					if ((int)(s->txTime - now) < soonest)
+						soonest = s->txTime - now;
+				}
+			}
+		}
+
+		if (!active)
+		{
+			TIMSK1 &= ~(1 << OCIE1B);
+			return;
+		}
+
+		// Schedule the next interrupt, unless that bit is due so soon
+		// that it is better to loop right away.
+		unsigned int next = now + soonest;
+		OCR1B = next;
+		TIFR1 = 1 << OCF1B;
+		if ((int)(next - TCNT1) > 2)
+			return;
+	}
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
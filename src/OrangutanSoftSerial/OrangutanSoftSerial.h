@@ -0,0 +1,155 @@
+/*
+  OrangutanSoftSerial.h - Software UART ports on arbitrary I/O pins, timed
+      with Timer1 compare match B, with the same buffer-based interface as
+      OrangutanSerial.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef OrangutanSoftSerial_h
+#define OrangutanSoftSerial_h
+
+#include "../OrangutanSerial/OrangutanSerial.h"
+
+// The number of software serial ports.  Each one uses about 30 bytes of RAM.
+#ifndef SOFT_SERIAL_PORTS
+#define SOFT_SERIAL_PORTS 2
+#endif
+
+// Pass this instead of a pin number to init() for a port that only sends
+// or only receives.
+#define SOFT_SERIAL_NO_PIN	0xFF
+
+#ifdef __cplusplus
+
+typedef struct SoftSerialPortState
+{
+	volatile unsigned char *rxPinRegister;	// 0 if the port does not receive
+	volatile unsigned char *rxPCMSK;		// pin change mask register of the RX pin
+	volatile unsigned char *txPortRegister;	// 0 if the port does not send
+	unsigned char rxMask;
+	unsigned char txMask;
+	unsigned int bitTicks;		// length of one bit in Timer1 ticks (0.4 us)
+
+	unsigned char rxBit;		// 0 when idle, else the number of the next data bit + 1 (9 = stop bit)
+	unsigned char rxIdle;		// 1 once the RX line has been seen high since the last start bit
+	unsigned char rxByte;
+	unsigned int rxTime;		// Timer1 time of the next RX sample
+
+	unsigned char txBit;		// 0 when idle, else the number of the next bit to send
+	unsigned char txByte;
+	unsigned int txTime;		// Timer1 time of the next TX bit
+} SoftSerialPortState;
+
+// Software serial ports work like the ports of OrangutanSerial in
+// SERIAL_AUTOMATIC mode: you give them buffers to send from and receive
+// into, and interrupts do the rest.  Each port has an RX pin, a TX pin,
+// or both, which can be any of the IO_* pins in OrangutanDigital.h, and
+// its own baud rate.  The format is 8 data bits, no parity and one stop
+// bit.
+//
+// Bits are timed with Timer1 running freely at 2.5 MHz, using its compare
+// match B interrupt, and start bits are detected with pin-change
+// interrupts.  This means software serial cannot be used together with
+// OrangutanServos, OrangutanBuzzer or OrangutanStepper (Timer1), or with
+// PololuWheelEncoders or OrangutanPulseIn (pin-change interrupts).
+//
+// Each bit costs one short interrupt per active direction, so the CPU
+// load grows with the total bit rate.  The 38400 baud figure below is an
+// estimate from the length of the interrupt code, not a measurement; the
+// test/soft-serial-load program measures the cycles per byte sent and
+// received on a board or in simavr.  Keep the sum of the baud rates of
+// all ports that are transferring data at the same time at or below
+// 38400; other interrupts that run for more than a few microseconds
+// (such as long millisecond callbacks) lower that limit.
+class OrangutanSoftSerial
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	OrangutanSoftSerial();
+
+	// Sets the pins of a software serial port (0 to SOFT_SERIAL_PORTS-1)
+	// and starts Timer1.  The TX pin becomes an output driven high (idle)
+	// and the RX pin an input with its pull-up enabled.
+	static void init(unsigned char port, unsigned char rx_pin, unsigned char tx_pin);
+
+	// The rest of the functions work like the OrangutanSerial functions
+	// of the same names.
+	static void setBaudRate(unsigned char port, unsigned long baud);
+
+	static void receive(unsigned char port, char *buffer, unsigned char size);
+	static char receiveBlocking(unsigned char port, char *buffer, unsigned char size, unsigned int timeout_ms);
+	static void receiveRing(unsigned char port, char *buffer, unsigned char size);
+	static inline void cancelReceive(unsigned char port) { receive(port, 0, 0); }
+	static inline unsigned char getReceivedBytes(unsigned char port) { return ports[port].receivedBytes; }
+	static inline char receiveBufferFull(unsigned char port) { return getReceivedBytes(port) == ports[port].receiveSize; }
+
+	static void send(unsigned char port, char *buffer, unsigned char size);
+	static void sendBlocking(unsigned char port, char *buffer, unsigned char size);
+	static inline unsigned char getSentBytes(unsigned char port) { return ports[port].sentBytes; }
+	static inline char sendBufferEmpty(unsigned char port) { return ports[port].sentBytes == ports[port].sendSize; }
+
+	// Don't call these functions.  They are only public because the
+	// interrupts in OrangutanSoftSerial.cpp need them.
+	static inline void timerInterrupt();
+	static inline void pinChangeInterrupt();
+
+  private:
+
+	static SerialPortData ports[SOFT_SERIAL_PORTS];
+	static SoftSerialPortState state[SOFT_SERIAL_PORTS];
+
+	static inline void receiveBit(unsigned char port);
+	static inline void sendBit(unsigned char port);
+	static void startSending(unsigned char port);
+	static void receive_inline(unsigned char port, char *buffer, unsigned char size, unsigned char ring);
+};
+
+extern "C" {
+#endif // __cplusplus
+
+void soft_serial_init(unsigned char port, unsigned char rx_pin, unsigned char tx_pin);
+void soft_serial_set_baud_rate(unsigned char port, unsigned long baud);
+void soft_serial_receive(unsigned char port, char *buffer, unsigned char size);
+char soft_serial_receive_blocking(unsigned char port, char *buffer, unsigned char size, unsigned int timeout_ms);
+void soft_serial_receive_ring(unsigned char port, char *buffer, unsigned char size);
+void soft_serial_cancel_receive(unsigned char port);
+unsigned char soft_serial_get_received_bytes(unsigned char port);
+char soft_serial_receive_buffer_full(unsigned char port);
+void soft_serial_send(unsigned char port, char *buffer, unsigned char size);
+void soft_serial_send_blocking(unsigned char port, char *buffer, unsigned char size);
+unsigned char soft_serial_get_sent_bytes(unsigned char port);
+char soft_serial_send_buffer_empty(unsigned char port);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
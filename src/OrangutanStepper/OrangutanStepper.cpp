@@ -0,0 +1,350 @@
+/*
+  OrangutanStepper.cpp - Interrupt-driven bipolar stepper motor control through
+      the Orangutan's two motor driver channels, with trapezoidal speed
+      profiles.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#include "OrangutanStepper.h"
+
+#ifndef _ORANGUTAN_X2
+
+#include "../OrangutanMotors/OrangutanMotors.h"
+#include "../PololuFixedMath/PololuFixedMath.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+
+// Timer1 runs at 20 MHz / 64 = 312.5 kHz while stepping.
+#define STEPPER_TIMER_FREQUENCY	312500UL
+#define STEPPER_TIMER_CONTROL	((1 << WGM12) | (1 << CS11) | (1 << CS10))	// CTC mode, clk/64
+
+// AVR446 first step delay: 0.676 * f * sqrt(2 / acceleration), so this
+// divided by the square root of the acceleration.
+#define STEPPER_FIRST_DELAY_NUMERATOR	298753UL
+
+// Coil currents (M1, M2) for each sixteenth of the electrical cycle, as
+// fractions of 255: I*sin(a) and I*cos(a), with full steps at 45 degrees.
+static const unsigned char coilTable[16][2] PROGMEM =
+{
+	{ 180, 180 }, {  98, 236 }, {   0, 255 }, {  98, 236 },
+	{ 180, 180 }, { 236,  98 }, { 255,   0 }, { 236,  98 },
+	{ 180, 180 }, {  98, 236 }, {   0, 255 }, {  98, 236 },
+	{ 180, 180 }, { 236,  98 }, { 255,   0 }, { 236,  98 },
+};
+
+// Bit n of these is set if coil M1 (or M2) is driven negative in phase n.
+#define COIL1_NEGATIVE	0x03F8	// phases 3 - 9
+#define COIL2_NEGATIVE	0x3F80	// phases 7 - 13
+
+unsigned char OrangutanStepper::stepMode = STEPPER_FULL_STEP;
+unsigned char OrangutanStepper::current;
+unsigned char OrangutanStepper::phase = 0;
+signed char OrangutanStepper::direction = 1;
+volatile long OrangutanStepper::position = 0;
+unsigned int OrangutanStepper::maxSpeed = 100;
+unsigned int OrangutanStepper::acceleration = 100;
+unsigned long OrangutanStepper::stepsLeft;
+unsigned long OrangutanStepper::decelerationStart;
+long OrangutanStepper::profileCount;
+unsigned int OrangutanStepper::stepDelay;
+unsigned int OrangutanStepper::minDelay;
+unsigned int OrangutanStepper::lastAccelerationDelay;
+unsigned int OrangutanStepper::remainder;
+
+#endif // !_ORANGUTAN_X2
+
+volatile unsigned char OrangutanStepper::state = OrangutanStepper::STOPPED;
+
+extern "C" void stepper_init(unsigned char step_mode, unsigned char current)
+{
+	OrangutanStepper::init(step_mode, current);
+}
+
+extern "C" void stepper_set_max_speed(unsigned int steps_per_second)
+{
+	OrangutanStepper::setMaxSpeed(steps_per_second);
+}
+
+extern "C" void stepper_set_acceleration(unsigned int steps_per_second_per_second)
+{
+	OrangutanStepper::setAcceleration(steps_per_second_per_second);
+}
+
+extern "C" unsigned char stepper_move_to(long position)
+{
+	return OrangutanStepper::moveTo(position);
+}
+
+extern "C" unsigned char stepper_move(long steps)
+{
+	return OrangutanStepper::move(steps);
+}
+
+extern "C" unsigned char stepper_is_moving()
+{
+	return OrangutanStepper::isMoving();
+}
+
+extern "C" long stepper_get_position()
+{
+	return OrangutanStepper::getPosition();
+}
+
+extern "C" void stepper_set_position(long position)
+{
+	OrangutanStepper::setPosition(position);
+}
+
+extern "C" void stepper_stop()
+{
+	OrangutanStepper::stop();
+}
+
+extern "C" void stepper_release()
+{
+	OrangutanStepper::release();
+}
+
+#ifndef _ORANGUTAN_X2
+
+ISR(TIMER1_COMPA_vect)
+{
+	OrangutanStepper::step();
+}
+
+void OrangutanStepper::init(unsigned char step_mode, unsigned char new_current)
+{
+	stop();
+	stepMode = step_mode;
+	current = new_current;
+
+	// start on a phase that the step mode can reach
+	phase &= ~(step_mode - 1);
+	energize();
+}
+
+void OrangutanStepper::setMaxSpeed(unsigned int steps_per_second)
+{
+	// The step delay at the maximum speed, 312500 / speed timer counts,
+	// must fit in 16 bits.
+	maxSpeed = steps_per_second < STEPPER_MIN_SPEED ? STEPPER_MIN_SPEED : steps_per_second;
+}
+
+void OrangutanStepper::setAcceleration(unsigned int steps_per_second_per_second)
+{
+	acceleration = steps_per_second_per_second ? steps_per_second_per_second : 1;
+}
+
+void OrangutanStepper::energize()
+{
+	unsigned char m1 = (pgm_read_byte(&coilTable[phase][0]) * current) >> 8;
+	unsigned char m2 = (pgm_read_byte(&coilTable[phase][1]) * current) >> 8;
+	unsigned int bit = 1 << phase;
+
+	OrangutanMotors::setSpeeds((COIL1_NEGATIVE & bit) ? -m1 : m1, (COIL2_NEGATIVE & bit) ? -m2 : m2);
+}
+
+void OrangutanStepper::stopTimer()
+{
+	TIMSK1 &= ~(1 << OCIE1A);
+	TCCR1B = 0;
+	state = STOPPED;
+}
+
+unsigned char OrangutanStepper::moveTo(long target)
+{
+	return move(target - getPosition());
+}
+
+unsigned char OrangutanStepper::move(long steps)
+{
+	if (state != STOPPED)
+		return 0;
+	if (steps == 0)
+		return 1;
+
+	direction = 1;
+	if (steps < 0)
+	{
+		direction = -1;
+		steps = -steps;
+	}
+	stepsLeft = steps;
+
+	// Steps needed to reach the maximum speed (v^2 / 2a), and the number
+	// of decelerating steps: the same, unless the move is too short to
+	// reach the maximum speed, in which case it decelerates over the
+	// second half.
+	unsigned long speedUpSteps = ((unsigned long)maxSpeed * maxSpeed) / (2UL * acceleration);
+	unsigned long decelerationSteps = steps / 2;
+	if (speedUpSteps < decelerationSteps)
+		decelerationSteps = speedUpSteps;
+	if (decelerationSteps == 0)
+		decelerationSteps = 1;
+	decelerationStart = decelerationSteps;
+
+	minDelay = STEPPER_TIMER_FREQUENCY / maxSpeed;
+	unsigned long firstDelay = STEPPER_FIRST_DELAY_NUMERATOR / PololuFixedMath::sqrt(acceleration);
+	if (firstDelay > 0xFFFF)
+		firstDelay = 0xFFFF;
+	stepDelay = firstDelay;
+	lastAccelerationDelay = minDelay;
+	remainder = 0;
+	profileCount = 0;
+
+	if (stepDelay <= minDelay)
+	{
+		stepDelay = minDelay;
+		state = RUNNING;
+	}
+	else
+	{
+		state = ACCELERATING;
+	}
+
+	// take the first step right away
+	TCCR1A = 0;
+	TCNT1 = 0;
+	OCR1A = 1;
+	TIFR1 = 1 << OCF1A;
+	TIMSK1 |= 1 << OCIE1A;
+	TCCR1B = STEPPER_TIMER_CONTROL;
+	return 1;
+}
+
+// Called from the Timer1 compare match interrupt: takes one step and
+// schedules the next one.
+inline void OrangutanStepper::step()
+{
+	phase = (phase + direction * stepMode) & 15;
+	energize();
+	position += direction;
+
+	if (--stepsLeft == 0)
+	{
+		stopTimer();
+		return;
+	}
+
+	unsigned int newDelay = stepDelay;
+	switch (state)
+	{
+	case ACCELERATING:
+	case DECELERATING:
+	{
+		// AVR446 equation 13, keeping the remainder so that rounding
+		// errors do not accumulate
+		profileCount++;
+		long numerator = 2L * stepDelay + remainder;
+		long denominator = 4 * profileCount + 1;
+		long delay = stepDelay - numerator / denominator;
+		remainder = numerator % denominator;
+		newDelay = (delay > 0xFFFF) ? 0xFFFF : delay;
+
+		if (state == ACCELERATING)
+		{
+			if (stepsLeft <= decelerationStart)
+			{
+				profileCount = -(long)stepsLeft;
+				state = DECELERATING;
+			}
+			else if (newDelay <= minDelay)
+			{
+				lastAccelerationDelay = newDelay;
+				newDelay = minDelay;
+				remainder = 0;
+				state = RUNNING;
+			}
+		}
+		break;
+	}
+
+	case RUNNING:
+		if (stepsLeft <= decelerationStart)
+		{
+			profileCount = -(long)stepsLeft;
+			newDelay = lastAccelerationDelay;
+			state = DECELERATING;
+		}
+		break;
+	}
+
+	stepDelay = newDelay;
+	OCR1A = newDelay - 1;
+}
+
+long OrangutanStepper::getPosition()
+{
+	unsigned char sreg = SREG;
+	cli();
+	long value = position;
+	SREG = sreg;
+	return value;
+}
+
+void OrangutanStepper::setPosition(long new_position)
+{
+	if (state != STOPPED)
+		return;
+
+	unsigned char sreg = SREG;
+	cli();
+	position = new_position;
+	SREG = sreg;
+}
+
+void OrangutanStepper::stop()
+{
+	stopTimer();
+}
+
+void OrangutanStepper::release()
+{
+	stopTimer();
+	OrangutanMotors::setSpeeds(0, 0);
+}
+
+#else // _ORANGUTAN_X2
+
+// The X2's motors are controlled over SPI, which cannot be used from an
+// interrupt, so these do nothing.
+void OrangutanStepper::init(unsigned char step_mode, unsigned char current) { }
+void OrangutanStepper::setMaxSpeed(unsigned int steps_per_second) { }
+void OrangutanStepper::setAcceleration(unsigned int steps_per_second_per_second) { }
+unsigned char OrangutanStepper::moveTo(long position) { return 0; }
+unsigned char OrangutanStepper::move(long steps) { return 0; }
+long OrangutanStepper::getPosition() { return 0; }
+void OrangutanStepper::setPosition(long position) { }
+void OrangutanStepper::stop() { }
+void OrangutanStepper::release() { }
+
+#endif // _ORANGUTAN_X2
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,155 @@
+/*
+  OrangutanStepper.h - Interrupt-driven bipolar stepper motor control through
+      the Orangutan's two motor driver channels, with trapezoidal speed
+      profiles.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef OrangutanStepper_h
+#define OrangutanStepper_h
+
+#include "../OrangutanResources/include/OrangutanModel.h"
+
+// step modes: the number of sixteenths of a full electrical cycle per step
+#define STEPPER_QUARTER_STEP	1
+#define STEPPER_HALF_STEP		2
+#define STEPPER_FULL_STEP		4
+
+// The lowest maximum speed, in steps per second, that the 16-bit step
+// timer can time.
+#define STEPPER_MIN_SPEED		5
+
+#ifdef __cplusplus
+
+// One coil of the stepper motor connects to motor output M1 and the other
+// to M2.  Steps are generated from the Timer1 compare match A interrupt,
+// so this cannot be used together with OrangutanServos or OrangutanBuzzer,
+// which also need Timer1.  It is not available on the Orangutan X2, whose
+// motors are controlled over SPI.
+//
+// Speeds follow the real-time trapezoidal profile of Atmel application
+// note AVR446: the motor accelerates at a constant rate up to the maximum
+// speed, runs, and decelerates to stop exactly on the target.  Each step
+// delay is computed from the previous one with a single division.
+class OrangutanStepper
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	OrangutanStepper() { }
+
+	// Sets the step mode (STEPPER_FULL_STEP, STEPPER_HALF_STEP or
+	// STEPPER_QUARTER_STEP) and the coil current (0 - 255, the magnitude
+	// passed to OrangutanMotors), and energizes the coils to hold the
+	// current position.  Positions and speeds are counted in steps of
+	// the selected mode.
+	static void init(unsigned char step_mode, unsigned char current);
+
+	// Sets the maximum speed in steps per second (STEPPER_MIN_SPEED -
+	// 65535; lower speeds are raised to STEPPER_MIN_SPEED) and the
+	// acceleration and deceleration in steps per second per second
+	// (at least 21).  These apply to the next move.
+	static void setMaxSpeed(unsigned int steps_per_second);
+	static void setAcceleration(unsigned int steps_per_second_per_second);
+
+	// Starts moving to the given absolute position and returns
+	// immediately.  Returns 1 if the move started, or 0 if the motor
+	// was still moving (the target is then ignored).
+	static unsigned char moveTo(long position);
+
+	// Like moveTo(), relative to the current position.
+	static unsigned char move(long steps);
+
+	// Returns 1 while a move is in progress.
+	static inline unsigned char isMoving() { return state != STOPPED; }
+
+	// Returns the current position in steps.
+	static long getPosition();
+
+	// Sets the current position without moving, if the motor is stopped.
+	static void setPosition(long position);
+
+	// Stops immediately (without decelerating), keeping the coils
+	// energized.
+	static void stop();
+
+	// Stops and turns off the coil current.  This saves power, but the
+	// motor has no holding torque.
+	static void release();
+
+	// Don't call this function.  It is only public because the Timer1
+	// compare match interrupt in OrangutanStepper.cpp needs it.
+	static inline void step();
+
+  private:
+
+	enum { STOPPED, ACCELERATING, RUNNING, DECELERATING };
+
+	static volatile unsigned char state;
+	static unsigned char stepMode;
+	static unsigned char current;
+	static unsigned char phase;			// sixteenths of the electrical cycle
+	static signed char direction;		// 1 or -1
+	static volatile long position;
+
+	static unsigned int maxSpeed;
+	static unsigned int acceleration;
+
+	static unsigned long stepsLeft;
+	static unsigned long decelerationStart;	// stepsLeft when deceleration begins
+	static long profileCount;		// n in the AVR446 recurrence (negative while decelerating)
+	static unsigned int stepDelay;	// timer counts until the next step
+	static unsigned int minDelay;	// step delay at the maximum speed
+	static unsigned int lastAccelerationDelay;
+	static unsigned int remainder;
+
+	static void energize();
+	static void stopTimer();
+};
+
+extern "C" {
+#endif // __cplusplus
+
+void stepper_init(unsigned char step_mode, unsigned char current);
+void stepper_set_max_speed(unsigned int steps_per_second);
+void stepper_set_acceleration(unsigned int steps_per_second_per_second);
+unsigned char stepper_move_to(long position);
+unsigned char stepper_move(long steps);
+unsigned char stepper_is_moving(void);
+long stepper_get_position(void);
+void stepper_set_position(long position);
+void stepper_stop(void);
+void stepper_release(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
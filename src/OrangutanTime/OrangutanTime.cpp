@@ -37,6 +37,29 @@ volatile unsigned long tickCount = 0;	// incremented by 256 every T2 OVF (units
 volatile unsigned long msCounter = 0;	// returned by millis(), updated by T2 OVF ISR
 unsigned int us_over_10 = 0;			// in units of 10^-7 s (intentionally not volatile)
 
+unsigned char msCallbackCount = 0;		// number of functions in OrangutanTime::msCallbacks
+
+void (*OrangutanTime::idleFunction)(void) = 0;
+unsigned char OrangutanTime::idlePolling = 0;
+void (*OrangutanTime::msCallbacks[TIME_MAX_MS_CALLBACKS])(void);
+
+// The timer interrupt below jumps here (after restoring everything it
+// changed) when the millisecond counter has incremented and there are
+// callbacks to run.  Unlike the timer interrupt, this is an ordinary
+// interrupt handler that saves every register the compiler uses, and it
+// re-enables interrupts so that the callbacks do not delay other ISRs.
+ISR(__vector_time_ms_callbacks, ISR_NOBLOCK)
+{
+	OrangutanTime::runMillisecondCallbacks();
+}
+
+// devices with more than 8 KB of flash need jmp to reach any address
+#if FLASHEND > 0x1FFF
+#define TIME_JUMP "jmp "
+#else
+#define TIME_JUMP "rjmp "
+#endif
+
 extern "C" void TIMER2_OVF_vect() __attribute__((naked, __INTR_ATTRS));
 extern "C" void TIMER2_OVF_vect()
 {
@@ -84,6 +107,15 @@ extern "C" void TIMER2_OVF_vect()
 		"adc  r24, r25"				"\n\t"	// carry from previous addition operation
 		"sts  msCounter+3, r24"		"\n\t"	// save the byte to RAM
 
+		"lds  r24, msCallbackCount"	"\n\t"	// if there are no millisecond callbacks,
+		"tst  r24"					"\n\t"	//  we are done
+		"breq end"					"\n\t"
+		"out  0x3f, r2"				"\n\t"	// otherwise restore everything we changed
+		"pop  r25"					"\n\t"	//  and continue in the callback handler,
+		"pop  r24"					"\n\t"	//  which returns from the interrupt
+		"pop  r2"					"\n\t"
+		TIME_JUMP "__vector_time_ms_callbacks"	"\n\t"
+
 		"end: out 0x3f, r2"			"\n\t"	// restore SREG
 		"pop r25"					"\n\t"	// restore the registers we used in this ISR
 		"pop r24"					"\n\t"
@@ -105,8 +137,15 @@ extern "C" {
 		return OrangutanTime::ticksToMicroseconds(numTicks);
 	}
 	unsigned long get_ms() { return OrangutanTime::ms(); }
+	unsigned long get_us() { return OrangutanTime::us(); }
 	void delay_ms(unsigned int milliseconds) { OrangutanTime::delayMilliseconds(milliseconds); }
 	void time_reset() { OrangutanTime::reset(); }
+	void time_set_idle_function(void (*function)(void)) { OrangutanTime::setIdleFunction(function); }
+	unsigned char time_add_ms_callback(void (*function)(void))
+	{
+		return OrangutanTime::addMillisecondCallback(function);
+	}
+	void time_remove_ms_callback(void (*function)(void)) { OrangutanTime::removeMillisecondCallback(function); }
 }
 
 // number of ticks (in units of 0.4 us) that have elapsed since OrangutanTime was
@@ -154,10 +193,49 @@ unsigned long OrangutanTime::ms()
 	return value;
 }
 
+// Microseconds are msCounter * 1000 plus the part of the current
+// millisecond, which is us_over_10 plus 4 for each count of TCNT2 (in
+// units of 0.1 us).  Since msCounter * 1000 overflows exactly when a
+// free-running microsecond counter would, the result overflows on an
+// even data boundary, just like ms().
+unsigned long OrangutanTime::us()
+{
+	init();
+	TIMSK2 &= ~(1 << TOIE2);	// disable timer2 overflow interrupt
+	unsigned long value = msCounter;
+	unsigned int tenths = us_over_10;
+	unsigned char count = TCNT2;
+	if (TIFR2 & (1 << TOV2))	// if TCNT2 has overflowed since we disabled t2 ovf interrupt
+	{
+		// Read TCNT2 again (see ticks()) and account for the overflow
+		// the ISR has not handled yet.  tenths can now exceed 10000, but
+		// the sum below is still right.
+		count = TCNT2;
+		tenths += 1024;
+	}
+	TIMSK2 |= 1 << TOIE2;	// enable timer2 overflow interrupt
+
+	tenths += count * 4;	// at most 9999 + 1024 + 1020
+
+	// tenths / 10 as a multiply by 2^19 / 10 (exact for tenths < 43699)
+	return value * 1000 + (unsigned int)(((unsigned long)tenths * 0xCCCD) >> 19);
+}
+
 void OrangutanTime::delayMilliseconds(unsigned int milliseconds)
 {
-	while (milliseconds--)
-	  delayMicroseconds(1000);
+	if (!idleFunction)
+	{
+		while (milliseconds--)
+		  delayMicroseconds(1000);
+		return;
+	}
+
+	// Measure the delay with the tick counter (2500 ticks per ms) so that
+	// time spent in the idle function counts toward it.
+	unsigned long start = ticks();
+	unsigned long duration = (unsigned long)milliseconds * 2500;
+	while (ticks() - start < duration)
+		idleFunction();
 }
 
 void OrangutanTime::init2()
@@ -181,6 +259,41 @@ void OrangutanTime::init2()
 	sei();				// enable global interrupts
 }
 
+unsigned char OrangutanTime::addMillisecondCallback(void (*function)(void))
+{
+	init();
+	if (msCallbackCount >= TIME_MAX_MS_CALLBACKS)
+		return 0;
+
+	// the timer interrupt only looks at the new entry once the count
+	// includes it
+	msCallbacks[msCallbackCount] = function;
+	msCallbackCount++;
+	return 1;
+}
+
+void OrangutanTime::removeMillisecondCallback(void (*function)(void))
+{
+	TIMSK2 &= ~(1 << TOIE2);	// disable timer2 overflow interrupt
+	for (unsigned char i = 0; i < msCallbackCount; i++)
+	{
+		if (msCallbacks[i] == function)
+		{
+			msCallbackCount--;
+			for (; i < msCallbackCount; i++)
+				msCallbacks[i] = msCallbacks[i+1];
+			break;
+		}
+	}
+	TIMSK2 |= 1 << TOIE2;	// enable timer2 overflow interrupt
+}
+
+inline void OrangutanTime::runMillisecondCallbacks()
+{
+	for (unsigned char i = 0; i < msCallbackCount; i++)
+		msCallbacks[i]();
+}
+
 // resets millisecond counter, but does not reset tick counter
 void OrangutanTime::reset()
 {
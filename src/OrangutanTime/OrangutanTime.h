@@ -25,6 +25,12 @@
 #ifndef OrangutanTime_h
 #define OrangutanTime_h
 
+// The maximum number of functions that can be registered with
+// addMillisecondCallback() at once.
+#ifndef TIME_MAX_MS_CALLBACKS
+#define TIME_MAX_MS_CALLBACKS 4
+#endif
+
 #ifdef __cplusplus
 
 class OrangutanTime
@@ -46,12 +52,77 @@ class OrangutanTime
 	// Returns the number of elapsed milliseconds.
 	static unsigned long ms();
 
-	// Returns the number of elapsed microseconds.
+	// Returns the number of elapsed microseconds.  Like ms(), it
+	// overflows on an even data boundary (after about 71.6 minutes), so
+	// differences and the deadline functions below stay correct across
+	// an overflow.  It is computed from the millisecond counter without
+	// any division, and reset() restarts it along with ms().
 	static unsigned long us();
 
-	// Delays for the specified number of milliseconds.
+	// Returns true once now has reached deadline.  Both are values
+	// from the same clock (ms(), us() or ticks()), e.g.
+	//   unsigned long deadline = OrangutanTime::us() + 500;
+	//   while (!OrangutanTime::deadlinePassed(OrangutanTime::us(), deadline)) { ... }
+	// This is correct across an overflow of the clock as long as the
+	// deadline is less than 2^31 units away.
+	static inline unsigned char deadlinePassed(unsigned long now, unsigned long deadline)
+	{
+		return (signed long)(now - deadline) >= 0;
+	}
+
+	// Returns how long it is from now until deadline, or 0 if the
+	// deadline has passed, in the units of their clock.
+	static inline unsigned long timeUntil(unsigned long now, unsigned long deadline)
+	{
+		signed long remaining = deadline - now;
+		return remaining > 0 ? remaining : 0;
+	}
+
+	// Delays for the specified number of milliseconds.  If an idle
+	// function has been set, it is called repeatedly during the delay.
 	static void delayMilliseconds(unsigned int milliseconds);
 
+	// Sets a function that the library's blocking routines call
+	// repeatedly while they wait (0 for none, the default).
+	// OrangutanScheduler uses this to keep its tasks running during
+	// delays.
+	static inline void setIdleFunction(void (*function)(void)) { idleFunction = function; }
+	static inline void (*getIdleFunction())(void) { return idleFunction; }
+
+	// Calls the idle function, if there is one.
+	static inline void idle()
+	{
+		if (idleFunction)
+			idleFunction();
+	}
+
+	// Like idle(), but for routines that must keep polling hardware
+	// (such as a serial port in SERIAL_CHECK mode): isPolling() returns 1
+	// while the idle function runs, telling it not to sleep.
+	static inline void poll()
+	{
+		unsigned char polling = idlePolling;
+		idlePolling = 1;
+		idle();
+		idlePolling = polling;
+	}
+
+	static inline unsigned char isPolling() { return idlePolling; }
+
+	// Registers a function to be called from the timer interrupt every
+	// time the millisecond counter increments.  The functions run with
+	// interrupts enabled, so they can be interrupted by other ISRs, but
+	// they must return well within a millisecond.  Returns 1 on success,
+	// or 0 if TIME_MAX_MS_CALLBACKS functions are already registered.
+	static unsigned char addMillisecondCallback(void (*function)(void));
+
+	// Unregisters a function registered with addMillisecondCallback().
+	static void removeMillisecondCallback(void (*function)(void));
+
+	// Don't call this function.  It is only public because the timer
+	// interrupt in OrangutanTime.cpp needs it.
+	static inline void runMillisecondCallbacks();
+
 	// Delays for for the specified nubmer of microseconds.
 	static inline void delayMicroseconds(unsigned int microseconds)
 	{
@@ -71,6 +142,10 @@ class OrangutanTime
 	
   private:
 
+	static void (*idleFunction)(void);
+	static unsigned char idlePolling;
+	static void (*msCallbacks[TIME_MAX_MS_CALLBACKS])(void);
+
 	// Initializes the timer.  This must be called before the
 	// milliseconds/microseconds elapsed time functions are used.  It
 	// is not required for the delay functions.
@@ -99,8 +174,12 @@ extern "C" {
 unsigned long get_ticks(void);
 unsigned long ticks_to_microseconds(unsigned long ticks);
 unsigned long get_ms(void);
+unsigned long get_us(void);
 void delay_ms(unsigned int milliseconds);
 void time_reset(void);
+void time_set_idle_function(void (*function)(void));
+unsigned char time_add_ms_callback(void (*function)(void));
+void time_remove_ms_callback(void (*function)(void));
 
 // This is inline for efficiency:
 static inline void delay_us(unsigned int microseconds)
@@ -120,7 +199,20 @@ static inline void delay_us(unsigned int microseconds)
 
 // These are alternative aliases:
 static inline void delay(unsigned int milliseconds) { delay_ms(milliseconds); }
+
+// Wrap-safe deadline checks for values from get_ms(), get_us() or
+// get_ticks(); see OrangutanTime::deadlinePassed() and timeUntil().
+static inline unsigned char deadline_passed(unsigned long now, unsigned long deadline)
+{
+	return (signed long)(now - deadline) >= 0;
+}
+static inline unsigned long time_until(unsigned long now, unsigned long deadline)
+{
+	signed long remaining = deadline - now;
+	return remaining > 0 ? remaining : 0;
+}
 static inline unsigned long millis(void) { return get_ms(); }
+static inline unsigned long micros(void) { return get_us(); }
 static inline void delayMicroseconds(unsigned int microseconds) { delay_us(microseconds); }
 
 #ifdef __cplusplus
@@ -0,0 +1,230 @@
+/*
+  OrangutanWatchdog.cpp - Watchdog supervisor that only feeds the watchdog
+      timer while every registered task keeps checking in on time.
+*/
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#include "OrangutanWatchdog.h"
+#include "../OrangutanTime/OrangutanTime.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/wdt.h>
+
+#define WATCHDOG_RECORD_SIGNATURE	0x5745
+
+// Not cleared by the C runtime at startup, so it survives a watchdog reset.
+static WatchdogRecord record __attribute__((section(".noinit")));
+
+unsigned char OrangutanWatchdog::resetFlags;
+unsigned char OrangutanWatchdog::taskMask = 0;
+unsigned int OrangutanWatchdog::deadline[WATCHDOG_MAX_TASKS];
+volatile unsigned int OrangutanWatchdog::lastCheckIn[WATCHDOG_MAX_TASKS];
+
+extern "C" void watchdog_init(unsigned char timeout)
+{
+	OrangutanWatchdog::init(timeout);
+}
+
+extern "C" void watchdog_add_task(unsigned char task, unsigned int deadline_ms)
+{
+	OrangutanWatchdog::addTask(task, deadline_ms);
+}
+
+extern "C" void watchdog_remove_task(unsigned char task)
+{
+	OrangutanWatchdog::removeTask(task);
+}
+
+extern "C" void watchdog_check_in(unsigned char task)
+{
+	OrangutanWatchdog::checkIn(task);
+}
+
+extern "C" void watchdog_service()
+{
+	OrangutanWatchdog::service();
+}
+
+extern "C" unsigned char watchdog_get_reset_flags()
+{
+	return OrangutanWatchdog::getResetFlags();
+}
+
+extern "C" unsigned char watchdog_get_failed_task()
+{
+	return OrangutanWatchdog::getFailedTask();
+}
+
+extern "C" unsigned long watchdog_get_failed_address()
+{
+	return OrangutanWatchdog::getFailedAddress();
+}
+
+extern "C" unsigned int watchdog_get_reset_count()
+{
+	return OrangutanWatchdog::getResetCount();
+}
+
+// The watchdog interrupt fires when service() has not fed the watchdog for
+// a whole period.  It never returns (recordFailure() waits for the reset),
+// so it does not need to save any registers.  Because it is naked, the
+// stack pointer still points just below the return address that the
+// interrupt pushed.
+ISR(WDT_vect, ISR_NAKED)
+{
+	__asm__ volatile ("clr __zero_reg__");
+	OrangutanWatchdog::recordFailure((const unsigned char *)SP);
+}
+
+OrangutanWatchdog::OrangutanWatchdog()
+{
+}
+
+void OrangutanWatchdog::init(unsigned char timeout)
+{
+	resetFlags = MCUSR;
+	MCUSR = 0;
+	wdt_disable();
+
+	if (!(resetFlags & (1 << WDRF)) || record.signature != WATCHDOG_RECORD_SIGNATURE)
+	{
+		// the last reset was not ours, so the record holds nothing useful
+		if (record.signature != WATCHDOG_RECORD_SIGNATURE || (resetFlags & ((1 << PORF) | (1 << BORF))))
+			record.resetCount = 0;
+		record.signature = WATCHDOG_RECORD_SIGNATURE;
+		record.task = WATCHDOG_NO_FAILURE;
+		record.address = 0;
+	}
+
+	// Convert the WDTO_* constant to prescaler bits and start the watchdog
+	// in interrupt-and-reset mode.  The timed sequence must not be
+	// interrupted.
+	unsigned char prescaler = (timeout & 0x07) | ((timeout & 0x08) ? (1 << WDP3) : 0);
+	unsigned char sreg = SREG;
+	cli();
+	wdt_reset();
+	WDTCSR = (1 << WDCE) | (1 << WDE);
+	WDTCSR = (1 << WDIE) | (1 << WDE) | prescaler;
+	SREG = sreg;
+}
+
+void OrangutanWatchdog::addTask(unsigned char task, unsigned int deadline_ms)
+{
+	if (task >= WATCHDOG_MAX_TASKS)
+		return;
+
+	deadline[task] = deadline_ms;
+	checkIn(task);
+	taskMask |= 1 << task;
+}
+
+void OrangutanWatchdog::removeTask(unsigned char task)
+{
+	if (task >= WATCHDOG_MAX_TASKS)
+		return;
+
+	taskMask &= ~(1 << task);
+}
+
+void OrangutanWatchdog::checkIn(unsigned char task)
+{
+	if (task >= WATCHDOG_MAX_TASKS)
+		return;
+
+	unsigned int now = (unsigned int)OrangutanTime::ms();
+	unsigned char sreg = SREG;
+	cli();
+	lastCheckIn[task] = now;
+	SREG = sreg;
+}
+
+unsigned char OrangutanWatchdog::lateTask()
+{
+	unsigned int now = (unsigned int)OrangutanTime::ms();
+
+	for (unsigned char task = 0; task < WATCHDOG_MAX_TASKS; task++)
+	{
+		if (!(taskMask & (1 << task)))
+			continue;
+
+		unsigned char sreg = SREG;
+		cli();
+		unsigned int last = lastCheckIn[task];
+		SREG = sreg;
+
+		if ((unsigned int)(now - last) > deadline[task])
+			return task;
+	}
+
+	return WATCHDOG_NO_FAILURE;
+}
+
+void OrangutanWatchdog::service()
+{
+	if (lateTask() == WATCHDOG_NO_FAILURE)
+		wdt_reset();
+}
+
+unsigned char OrangutanWatchdog::getFailedTask()
+{
+	return record.task;
+}
+
+unsigned long OrangutanWatchdog::getFailedAddress()
+{
+	return record.address;
+}
+
+unsigned int OrangutanWatchdog::getResetCount()
+{
+	return record.resetCount;
+}
+
+void OrangutanWatchdog::recordFailure(const unsigned char *stack)
+{
+	// The return address is stored big-endian, in words.  It takes three
+	// bytes on parts with a 3-byte PC; on the others the byte address
+	// still needs 17 bits when the flash is 128 KB.
+#ifdef __AVR_3_BYTE_PC__
+	unsigned long word = ((unsigned long)stack[1] << 16) | ((unsigned int)stack[2] << 8) | stack[3];
+#else
+	unsigned long word = ((unsigned int)stack[1] << 8) | stack[2];
+#endif
+	record.address = word << 1;
+
+	unsigned char task = lateTask();
+	record.task = (task == WATCHDOG_NO_FAILURE) ? WATCHDOG_SERVICE_MISSED : task;
+	record.resetCount++;
+	record.signature = WATCHDOG_RECORD_SIGNATURE;
+
+	// reset as soon as possible instead of waiting a whole period
+	wdt_enable(WDTO_15MS);
+	while (1)
+		;
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,144 @@
+/*
+  OrangutanWatchdog.h - Watchdog supervisor that only feeds the watchdog
+      timer while every registered task keeps checking in on time.
+*/
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+#ifndef OrangutanWatchdog_h
+#define OrangutanWatchdog_h
+
+#include <avr/wdt.h>	// for the WDTO_* timeout constants
+
+// Task numbers are 0 to WATCHDOG_MAX_TASKS-1.
+#define WATCHDOG_MAX_TASKS		8
+
+// Values returned by getFailedTask() when no task missed its deadline.
+#define WATCHDOG_NO_FAILURE		0xFF	// the last reset was not caused by the supervisor
+#define WATCHDOG_SERVICE_MISSED	0xFE	// all tasks were on time, but service() stopped being called
+
+#ifdef __cplusplus
+
+// Information about the last supervisor reset.  It lives in .noinit RAM,
+// so it survives the watchdog reset.
+typedef struct WatchdogRecord
+{
+	unsigned int signature;		// tells a valid record from power-on garbage
+	unsigned char task;			// task that missed its deadline, or WATCHDOG_SERVICE_MISSED
+	unsigned long address;		// byte address of the code that was running
+	unsigned int resetCount;	// supervisor resets since the last power-on
+} WatchdogRecord;
+
+class OrangutanWatchdog
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	OrangutanWatchdog();
+
+	// Starts the supervisor with a watchdog period given by one of the
+	// WDTO_* constants from <avr/wdt.h>.  Call this at the very start
+	// of main(): it reads and clears the reset flags (which is required
+	// to turn the watchdog off after a watchdog reset) and loads the
+	// failure record left behind by the previous reset.  Use
+	// getResetFlags() instead of get_reset_flags() afterwards.
+	//
+	// The watchdog runs in interrupt-and-reset mode.  When it expires,
+	// its interrupt records which task was late and what code was
+	// running, and then the AVR resets about 15 ms later.
+	static void init(unsigned char timeout);
+
+	// Makes the supervisor require that the given task checks in at
+	// least every deadline_ms milliseconds.  The task counts as having
+	// just checked in.
+	static void addTask(unsigned char task, unsigned int deadline_ms);
+
+	// Stops supervising the given task.
+	static void removeTask(unsigned char task);
+
+	// Records that the given task is alive.  This is short enough to
+	// call from an interrupt.
+	static void checkIn(unsigned char task);
+
+	// Feeds the watchdog if every registered task has checked in within
+	// its deadline.  Call this more often than the watchdog period, for
+	// example from the main loop or as an OrangutanScheduler task:
+	//   OrangutanScheduler::addTask(OrangutanWatchdog::service, 10, 0);
+	static void service();
+
+	// Returns the reset flags saved by init() (see the x_RESET constants
+	// in OrangutanResources.h).
+	static inline unsigned char getResetFlags() { return resetFlags; }
+
+	// Returns the task that missed its deadline before the last reset,
+	// WATCHDOG_SERVICE_MISSED, or WATCHDOG_NO_FAILURE if the last reset
+	// was not caused by the supervisor.
+	static unsigned char getFailedTask();
+
+	// Returns the flash byte address of the code that was running when
+	// the supervisor gave up.  Look it up in the .lss/.map file to find
+	// the code path that stalled.  Only meaningful when getFailedTask()
+	// does not return WATCHDOG_NO_FAILURE.  Addresses above 64 KB (on
+	// the ATmega1284P) are returned in full.
+	static unsigned long getFailedAddress();
+
+	// Returns how many supervisor resets have happened since power-on.
+	static unsigned int getResetCount();
+
+	// Don't call this function.  It is only public because the watchdog
+	// interrupt in OrangutanWatchdog.cpp needs it.
+	static void recordFailure(const unsigned char *stack) __attribute__((noreturn));
+
+  private:
+
+	static unsigned char resetFlags;
+	static unsigned char taskMask;		// bit n is set if task n is registered
+	static unsigned int deadline[WATCHDOG_MAX_TASKS];
+	static volatile unsigned int lastCheckIn[WATCHDOG_MAX_TASKS];
+
+	// returns the first task that is past its deadline, or WATCHDOG_NO_FAILURE
+	static unsigned char lateTask();
+};
+
+extern "C" {
+#endif // __cplusplus
+
+void watchdog_init(unsigned char timeout);
+void watchdog_add_task(unsigned char task, unsigned int deadline_ms);
+void watchdog_remove_task(unsigned char task);
+void watchdog_check_in(unsigned char task);
+void watchdog_service(void);
+unsigned char watchdog_get_reset_flags(void);
+unsigned char watchdog_get_failed_task(void);
+unsigned long watchdog_get_failed_address(void);
+unsigned int watchdog_get_reset_count(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -25,10 +25,16 @@
 #include "../OrangutanResources/include/OrangutanModel.h"
 #include "../OrangutanSPIMaster/OrangutanSPIMaster.h"
 #include "../OrangutanTime/OrangutanTime.h"
+#include "../OrangutanScheduler/OrangutanScheduler.h"
 #include "OrangutanX2.h"
 
 #ifdef _ORANGUTAN_X2
 
+X2EEPROMWrite OrangutanX2::eepromQueue[X2_EEPROM_QUEUE_SIZE];
+unsigned char OrangutanX2::eepromQueueHead = 0;
+unsigned char OrangutanX2::eepromQueueCount = 0;
+unsigned char OrangutanX2::eepromQueueDone = 1;
+
 
 extern "C" void x2_get_firmware_version(unsigned char *vmajor, unsigned char *vminor)
 {
@@ -70,6 +76,42 @@ extern "C" unsigned char x2_read_parameter(unsigned int param_address)
 	return OrangutanX2::readParameter(param_address);
 }
 
+extern "C" unsigned char x2_queue_eeprom_byte(unsigned int address, unsigned char data)
+{
+	return OrangutanX2::queueEEPROMByte(address, data);
+}
+
+extern "C" unsigned char x2_queue_parameter(unsigned int param_address, unsigned char param_value)
+{
+	return OrangutanX2::queueParameter(param_address, param_value);
+}
+
+extern "C" unsigned char x2_queue_eeprom_bytes(unsigned int address, const unsigned char *data,
+	unsigned char count)
+{
+	return OrangutanX2::queueEEPROMBytes(address, data, count);
+}
+
+extern "C" unsigned char x2_is_eeprom_queue_done()
+{
+	return OrangutanX2::isEEPROMQueueDone();
+}
+
+extern "C" unsigned char x2_get_eeprom_queue_length()
+{
+	return OrangutanX2::getEEPROMQueueLength();
+}
+
+extern "C" void x2_flush_eeprom_queue()
+{
+	OrangutanX2::flushEEPROMQueue();
+}
+
+extern "C" void x2_service_eeprom_queue()
+{
+	OrangutanX2::serviceEEPROMQueue();
+}
+
 // ***************** MOTORS *****************
 
 extern "C" void x2_set_motor(unsigned char motor, unsigned char operation_mode, int speed)
@@ -236,8 +278,15 @@ void OrangutanX2::writeToEEPROM(unsigned int address, unsigned char data)
 	if (address >= 512)		// address out of bounds
 		return;
 
+	flushEEPROMQueue();		// keep queued writes in order
 	waitForEEPROM();		// wait for any current EEPROM writes to finish
+	sendEEPROMWrite(address, data);
+}
 
+// Sends the EEPROM write command without checking whether the EEPROM is
+// busy.  This is a PRIVATE method.
+void OrangutanX2::sendEEPROMWrite(unsigned int address, unsigned char data)
+{
 	// insert data MSB and address bits 7 and 8 into the command byte
 	OrangutanSPIMaster::transmit(CMD_WRITE_EEPROM | ((data & 0x80) >> 5)
 								  | ((address & 0x0080) >> 6)
@@ -255,8 +304,15 @@ unsigned char OrangutanX2::readEEPROMByte(unsigned int address)
 	if (address >= 512)		// address out of bounds
 		return 0;
 
+	flushEEPROMQueue();		// make sure queued writes have landed
 	waitForEEPROM();		// wait for any current EEPROM writes to finish
-	
+	return sendEEPROMRead(address);
+}
+
+// Sends the EEPROM read command without checking whether the EEPROM is
+// busy.  This is a PRIVATE method.
+unsigned char OrangutanX2::sendEEPROMRead(unsigned int address)
+{
 	// insert address bits 7 and 8 into the command byte
 	OrangutanSPIMaster::transmit(CMD_READ_EEPROM | ((address & 0x0080) >> 6)
 								 | ((address & 0x0100) >> 8));
@@ -275,6 +331,87 @@ unsigned char OrangutanX2::isEEPROMBusy()
 }
 
 
+// Adds a write to the EEPROM write-behind queue, or updates the data of a
+// queued write to the same address, and makes sure the scheduler task that
+// services the queue is registered.  This is a PRIVATE method.
+unsigned char OrangutanX2::queueEEPROMWrite(unsigned int address, unsigned char data)
+{
+	if (address >= 512)		// address out of bounds
+		return 0;
+
+	unsigned char i;
+	unsigned char index = eepromQueueHead;
+	for (i = 0; i < eepromQueueCount; i++)
+	{
+		if (eepromQueue[index].address == address)
+		{
+			eepromQueue[index].data = data;
+			return 1;
+		}
+		if (++index >= X2_EEPROM_QUEUE_SIZE)
+			index = 0;
+	}
+
+	if (eepromQueueCount >= X2_EEPROM_QUEUE_SIZE)
+		return 0;
+
+	if (eepromQueueDone && !OrangutanScheduler::addTask(serviceEEPROMQueue, 1, 2))
+		return 0;
+
+	// index now points at the free slot after the last queued write
+	eepromQueue[index].address = address;
+	eepromQueue[index].data = data;
+	eepromQueueCount++;
+	eepromQueueDone = 0;
+	return 1;
+}
+
+unsigned char OrangutanX2::queueEEPROMBytes(unsigned int address, const unsigned char *data,
+	unsigned char count)
+{
+	unsigned char i;
+	for (i = 0; i < count; i++)
+	{
+		if (!queueEEPROMByte(address + i, data[i]))
+			break;
+	}
+	return i;
+}
+
+void OrangutanX2::serviceEEPROMQueue()
+{
+	if (eepromQueueDone || isEEPROMBusy())
+		return;
+
+	// Start the first queued write that actually changes the EEPROM.  Each
+	// write keeps the auxiliary MCU busy for a few milliseconds, so at most
+	// one is started per call.
+	while (eepromQueueCount)
+	{
+		X2EEPROMWrite *entry = &eepromQueue[eepromQueueHead];
+		if (++eepromQueueHead >= X2_EEPROM_QUEUE_SIZE)
+			eepromQueueHead = 0;
+		eepromQueueCount--;
+
+		if (sendEEPROMRead(entry->address) != entry->data)
+		{
+			sendEEPROMWrite(entry->address, entry->data);
+			return;
+		}
+	}
+
+	// The queue is empty and the EEPROM is idle, so everything is written.
+	eepromQueueDone = 1;
+	OrangutanScheduler::removeTask(serviceEEPROMQueue);
+}
+
+void OrangutanX2::flushEEPROMQueue()
+{
+	while (!eepromQueueDone)
+		serviceEEPROMQueue();
+}
+
+
 
 //****************************************************************************
 // Motor
@@ -215,6 +215,17 @@
 // there is room in EEPROM for 159 notes, distributed in any way amongst the
 // eight melodies.  The mega168's EEPROM is 512 bytes in size.
 
+// number of writes the EEPROM write-behind queue can hold (3 bytes of RAM each)
+#ifndef X2_EEPROM_QUEUE_SIZE
+#define X2_EEPROM_QUEUE_SIZE	32
+#endif
+
+typedef struct X2EEPROMWrite
+{
+	unsigned int address;
+	unsigned char data;
+} X2EEPROMWrite;
+
 #ifdef __cplusplus
 
 // C++ Function Declarations
@@ -224,6 +235,14 @@ class OrangutanX2
   private:
 	static void writeToEEPROM(unsigned int address, unsigned char data);
 	static unsigned char isEEPROMBusy();
+	static void sendEEPROMWrite(unsigned int address, unsigned char data);
+	static unsigned char sendEEPROMRead(unsigned int address);
+	static unsigned char queueEEPROMWrite(unsigned int address, unsigned char data);
+
+	static X2EEPROMWrite eepromQueue[X2_EEPROM_QUEUE_SIZE];
+	static unsigned char eepromQueueHead;
+	static unsigned char eepromQueueCount;
+	static unsigned char eepromQueueDone;
 
 	// Delays execution until the EEPROM on the auxiliary MCU is available for
 	// writing or reading.  This is a PRIVATE method.
@@ -268,6 +287,54 @@ class OrangutanX2
 	{
 		writeToEEPROM(paramAddress, paramValue);
 	}
+
+	// These methods are like saveEEPROMByte() and saveParameter(), but
+	// instead of waiting for the auxiliary MCU's EEPROM they add the write
+	// to a queue and return immediately.  The queue is serviced by an
+	// OrangutanScheduler task, which starts one write each time the EEPROM
+	// is free and skips bytes whose stored value already matches.  Writing
+	// an address that is already in the queue just replaces its data.
+	// They return 1 if the write was queued, or 0 if the address is
+	// 512 or more, the queue (X2_EEPROM_QUEUE_SIZE writes) is full, or the
+	// scheduler has no free task slot.  Like saveEEPROMByte(),
+	// queueEEPROMByte() ignores addresses in the parameter address space
+	// (address <= 23): nothing is queued, but it still returns 1.
+	static inline unsigned char queueEEPROMByte(unsigned int address, unsigned char data)
+	{
+		if (address > 23)
+			return queueEEPROMWrite(address, data);
+		return 1;
+	}
+
+	static inline unsigned char queueParameter(unsigned int paramAddress, unsigned char paramValue)
+	{
+		return queueEEPROMWrite(paramAddress, paramValue);
+	}
+
+	// Queues count bytes from data (in RAM) to be written starting at
+	// the given EEPROM address, which must be outside the parameter
+	// address space.  Returns the number of bytes that were queued.
+	static unsigned char queueEEPROMBytes(unsigned int address, const unsigned char *data,
+		unsigned char count);
+
+	// Returns 1 once every queued write has been written (or skipped)
+	// and the EEPROM has finished the last one, 0 while writes are still
+	// pending.  It is cleared whenever a new write is queued.
+	static inline unsigned char isEEPROMQueueDone() { return eepromQueueDone; }
+
+	// Returns the number of queued writes that have not been started yet.
+	static inline unsigned char getEEPROMQueueLength() { return eepromQueueCount; }
+
+	// Waits until isEEPROMQueueDone() is 1.  The blocking EEPROM functions
+	// (saveEEPROMByte(), saveParameter(), readEEPROMByte(), and the
+	// functions with a save argument) call this first, so they always
+	// see queued writes in order.
+	static void flushEEPROMQueue();
+
+	// Checks whether the EEPROM is free and, if so, starts the next
+	// queued write.  This is the OrangutanScheduler task; you only need
+	// to call it yourself if you do not use the scheduler.
+	static void serviceEEPROMQueue();
 	
 	static unsigned char readEEPROMByte(unsigned int address);
 
@@ -319,6 +386,14 @@ void x2_save_eeprom_byte(unsigned int address, unsigned char data);
 void x2_save_parameter(unsigned int param_address, unsigned char param_value);
 unsigned char x2_read_eeprom_byte(unsigned int address);
 unsigned char x2_read_parameter(unsigned int param_address);
+unsigned char x2_queue_eeprom_byte(unsigned int address, unsigned char data);
+unsigned char x2_queue_parameter(unsigned int param_address, unsigned char param_value);
+unsigned char x2_queue_eeprom_bytes(unsigned int address, const unsigned char *data,
+	unsigned char count);
+unsigned char x2_is_eeprom_queue_done(void);
+unsigned char x2_get_eeprom_queue_length(void);
+void x2_flush_eeprom_queue(void);
+void x2_service_eeprom_queue(void);
 
 void x2_set_motor(unsigned char motor, unsigned char operation_mode, int speed);
 void x2_set_pwm_frequencies(unsigned char m1_resolution, unsigned char m1_prescaler,
@@ -0,0 +1,193 @@
+/*
+  PololuFixedMath.cpp - Fixed-point sine, cosine, atan2, square root and Q15
+      multiplication that avoid the AVR's slow floating-point library.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#include "PololuFixedMath.h"
+
+#include <avr/pgmspace.h>
+
+// sin(i * 90 / 64 degrees) in Q15 format, for i = 0 to 64
+static const int sineTable[65] PROGMEM =
+{
+	    0,   804,  1608,  2410,  3212,  4011,  4808,  5602,
+	 6393,  7179,  7962,  8739,  9512, 10278, 11039, 11793,
+	12539, 13279, 14010, 14732, 15446, 16151, 16846, 17530,
+	18204, 18868, 19519, 20159, 20787, 21403, 22005, 22594,
+	23170, 23731, 24279, 24811, 25329, 25832, 26319, 26790,
+	27245, 27683, 28105, 28510, 28898, 29268, 29621, 29956,
+	30273, 30571, 30852, 31113, 31356, 31580, 31785, 31971,
+	32137, 32285, 32412, 32521, 32609, 32678, 32728, 32757,
+	32767
+};
+
+// atan(2^-i) in binary angle units, for i = 0 to 13
+static const unsigned int arctangentTable[14] PROGMEM =
+{
+	8192, 4836, 2555, 1297, 651, 326, 163, 81, 41, 20, 10, 5, 3, 1
+};
+
+extern "C" int fixed_sin(unsigned int angle)
+{
+	return PololuFixedMath::sin(angle);
+}
+
+extern "C" int fixed_cos(unsigned int angle)
+{
+	return PololuFixedMath::cos(angle);
+}
+
+extern "C" unsigned int fixed_atan2(int y, int x)
+{
+	return PololuFixedMath::atan2(y, x);
+}
+
+extern "C" unsigned int fixed_sqrt(unsigned long x)
+{
+	return PololuFixedMath::sqrt(x);
+}
+
+extern "C" unsigned int fixed_hypot(int x, int y)
+{
+	return PololuFixedMath::hypot(x, y);
+}
+
+int PololuFixedMath::sin(unsigned int angle)
+{
+	// The top two bits select the quadrant, the next six the table
+	// entry and the low eight bits interpolate between two entries.
+	unsigned char quadrant = angle >> 14;
+	unsigned int offset = angle & 0x3FFF;
+	if (quadrant & 1)
+		offset = 0x4000 - offset;	// mirror the second and fourth quadrants
+
+	unsigned char index = offset >> 8;
+	unsigned char fraction = offset;
+	int value = pgm_read_word(&sineTable[index]);
+	if (fraction)
+	{
+		int next = pgm_read_word(&sineTable[index + 1]);
+		value += ((long)(next - value) * fraction + 128) >> 8;
+	}
+
+	return (quadrant & 2) ? -value : value;
+}
+
+unsigned int PololuFixedMath::atan2(int y, int x)
+{
+	long lx = x, ly = y;
+	unsigned int angle = 0;
+
+	// rotate the vector into the right half-plane
+	if (lx < 0)
+	{
+		lx = -lx;
+		ly = -ly;
+		angle = FIXED_ANGLE_180;
+	}
+
+	// Scale the vector so that x | |y| is between 2^12 and 2^13 - 1,
+	// which puts the highest set bit of both components at or below bit
+	// 12: big enough for accuracy, small enough that the length times
+	// the CORDIC gain of 1.65 (at most about 19100) cannot overflow 16
+	// bits.
+	long magnitude = lx | (ly < 0 ? -ly : ly);
+	if (magnitude == 0)
+		return 0;
+	while (magnitude >= 0x2000)
+	{
+		magnitude >>= 1;
+		lx >>= 1;
+		ly >>= 1;
+	}
+	while (magnitude < 0x1000)
+	{
+		magnitude <<= 1;
+		lx <<= 1;
+		ly <<= 1;
+	}
+
+	int cx = lx, cy = ly;
+	for (unsigned char i = 0; i < 14; i++)
+	{
+		// rotate toward the x axis by atan(2^-i)
+		int dx = cy >> i;
+		int dy = cx >> i;
+		unsigned int step = pgm_read_word(&arctangentTable[i]);
+		if (cy > 0)
+		{
+			cx += dx;
+			cy -= dy;
+			angle += step;
+		}
+		else
+		{
+			cx -= dx;
+			cy += dy;
+			angle -= step;
+		}
+	}
+
+	return angle;
+}
+
+unsigned int PololuFixedMath::sqrt(unsigned long x)
+{
+	// digit-by-digit method, one result bit per iteration
+	unsigned long result = 0;
+	unsigned long bit = 1UL << 30;
+
+	while (bit > x)
+		bit >>= 2;
+
+	while (bit)
+	{
+		if (x >= result + bit)
+		{
+			x -= result + bit;
+			result = (result >> 1) + bit;
+		}
+		else
+		{
+			result >>= 1;
+		}
+		bit >>= 2;
+	}
+
+	return result;
+}
+
+unsigned int PololuFixedMath::hypot(int x, int y)
+{
+	// Each square fits in a long, but their sum can reach 2^31 at
+	// (-32768, -32768), so add them as unsigned.
+	return sqrt((unsigned long)((long)x * x) + (unsigned long)((long)y * y));
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,102 @@
+/*
+  PololuFixedMath.h - Fixed-point sine, cosine, atan2, square root and Q15
+      multiplication that avoid the AVR's slow floating-point library.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef PololuFixedMath_h
+#define PololuFixedMath_h
+
+// Angles are unsigned 16-bit binary angles: 65536 units make a full circle,
+// so they wrap around correctly with ordinary integer arithmetic.  Results
+// of sine and cosine are in Q15 format (32767 represents 1.0).
+#define FIXED_ANGLE_FROM_DEGREES(degrees)	((unsigned int)(long)((degrees) * 65536.0 / 360 + 0.5))
+#define FIXED_ANGLE_TO_DEGREES(angle)		((unsigned int)(((unsigned long)(angle) * 360 + 32768) >> 16))
+#define FIXED_ANGLE_90						16384
+#define FIXED_ANGLE_180						32768u
+
+// Q15_FROM_FLOAT saturates, so 1.0 gives Q15_ONE rather than wrapping
+// around to -32768.
+#define Q15_ONE		32767
+#define Q15_FROM_FLOAT(value)	((value) * 32768.0 >= Q15_ONE ? Q15_ONE : \
+								 (value) <= -1.0 ? -Q15_ONE - 1 : \
+								 (int)((value) * 32768.0 + ((value) < 0 ? -0.5 : 0.5)))
+
+#ifdef __cplusplus
+
+class PololuFixedMath
+{
+  public:
+
+	// Returns the sine of a binary angle in Q15 format, interpolated
+	// from a 65-entry quarter-wave table in program space.  The error is
+	// at most 3 in 32767 (checked by host/fixed-math).
+	static int sin(unsigned int angle);
+
+	// Returns the cosine of a binary angle in Q15 format.
+	static inline int cos(unsigned int angle) { return sin(angle + FIXED_ANGLE_90); }
+
+	// Returns the binary angle of the vector (x, y), measured
+	// counterclockwise from the positive x axis, computed with 14 CORDIC
+	// iterations.  The error is at most 13 binary angle units (0.07
+	// degrees), the worst found in a billion random vectors; see
+	// host/fixed-math.  atan2(0, 0) returns 0.
+	static unsigned int atan2(int y, int x);
+
+	// Returns the integer square root of x, rounded down.
+	static unsigned int sqrt(unsigned long x);
+
+	// Returns the length of the vector (x, y), rounded down.
+	static unsigned int hypot(int x, int y);
+
+	// Multiplies two Q15 numbers, or an integer by a Q15 number.
+	static inline int q15Multiply(int a, int b) { return ((long)a * b) >> 15; }
+};
+
+extern "C" {
+#endif // __cplusplus
+
+int fixed_sin(unsigned int angle);
+int fixed_cos(unsigned int angle);
+unsigned int fixed_atan2(int y, int x);
+unsigned int fixed_sqrt(unsigned long x);
+unsigned int fixed_hypot(int x, int y);
+
+// This is inline for efficiency:
+static inline int q15_multiply(int a, int b)
+{
+	return ((long)a * b) >> 15;
+}
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -0,0 +1,156 @@
+/*
+  PololuOdometry.cpp - Fixed-point differential-drive odometry that integrates
+      wheel encoder counts at a fixed rate from the OrangutanTime interrupt.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#include "PololuOdometry.h"
+#include "../PololuWheelEncoders/PololuWheelEncoders.h"
+#include "../PololuFixedMath/PololuFixedMath.h"
+#include "../OrangutanTime/OrangutanTime.h"
+
+#include <avr/io.h>
+#include <avr/interrupt.h>
+
+// 2^32 / (2 pi): the number of fine heading units (2^32 per turn) in one
+// radian.
+#define FINE_UNITS_PER_RADIAN	683565276UL
+
+unsigned int PololuOdometry::umPerCount;
+unsigned long PololuOdometry::headingPerCount;
+unsigned char PololuOdometry::period;
+unsigned char PololuOdometry::msUntilUpdate;
+long PololuOdometry::x = 0;
+long PololuOdometry::y = 0;
+unsigned long PololuOdometry::heading = 0;
+unsigned long PololuOdometry::time = 0;
+
+extern "C" void odometry_init(unsigned int um_per_count, unsigned int wheel_base_mm, unsigned char period_ms)
+{
+	PololuOdometry::init(um_per_count, wheel_base_mm, period_ms);
+}
+
+extern "C" void odometry_stop()
+{
+	PololuOdometry::stop();
+}
+
+extern "C" void odometry_get_pose(OdometryPose *pose)
+{
+	PololuOdometry::getPose(pose);
+}
+
+extern "C" void odometry_set_pose(long x, long y, unsigned int heading)
+{
+	PololuOdometry::setPose(x, y, heading);
+}
+
+void PololuOdometry::init(unsigned int um_per_count, unsigned int wheel_base_mm, unsigned char period_ms)
+{
+	stop();
+
+	// The heading changes by (right - left) * um_per_count / wheel base
+	// radians per update.  Split the division so that nothing overflows.
+	unsigned long wheelBase = wheel_base_mm * 1000UL;
+	headingPerCount = (FINE_UNITS_PER_RADIAN / wheelBase) * um_per_count
+		+ (FINE_UNITS_PER_RADIAN % wheelBase) * um_per_count / wheelBase;
+	umPerCount = um_per_count;
+	period = period_ms ? period_ms : 1;
+	msUntilUpdate = period;
+
+	setPose(0, 0, 0);
+
+	// discard anything counted before now
+	PololuWheelEncoders::getCountsAndResetM1();
+	PololuWheelEncoders::getCountsAndResetM2();
+
+	OrangutanTime::addMillisecondCallback(update);
+}
+
+void PololuOdometry::stop()
+{
+	OrangutanTime::removeMillisecondCallback(update);
+}
+
+void PololuOdometry::getPose(OdometryPose *pose)
+{
+	unsigned char sreg = SREG;
+	cli();
+	pose->x = x;
+	pose->y = y;
+	pose->heading = heading >> 16;
+	pose->time = time;
+	SREG = sreg;
+}
+
+void PololuOdometry::setPose(long new_x, long new_y, unsigned int new_heading)
+{
+	unsigned char sreg = SREG;
+	cli();
+	x = new_x;
+	y = new_y;
+	heading = (unsigned long)new_heading << 16;
+	SREG = sreg;
+}
+
+// Called every millisecond from the OrangutanTime interrupt.
+void PololuOdometry::update()
+{
+	if (--msUntilUpdate)
+		return;
+	msUntilUpdate = period;
+
+	int left = PololuWheelEncoders::getCountsAndResetM1();
+	int right = PololuWheelEncoders::getCountsAndResetM2();
+	unsigned long now = OrangutanTime::ms();
+
+	// distance traveled by the center of the robot, in micrometers
+	long distance = (long)(left + right) * umPerCount / 2;
+	unsigned long turn = (long)(right - left) * (long)headingPerCount;
+
+	// Move in the direction of the chord of the arc, which is the
+	// average of the old and new headings for an arc of constant
+	// curvature.  The step length is the arc length, which is longer
+	// than the chord by about distance * turn^2 / 24 (turn in radians):
+	// about 20 um for a 5 degree turn over 65 mm, and 0.8 um for 1
+	// degree.  The sine table adds up to about 6 um more at 65 mm.
+	unsigned int midHeading = (heading + (long)turn / 2) >> 16;
+
+	long dx = (distance * PololuFixedMath::cos(midHeading) + 16384) >> 15;
+	long dy = (distance * PololuFixedMath::sin(midHeading) + 16384) >> 15;
+
+	unsigned char sreg = SREG;
+	cli();
+	x += dx;
+	y += dy;
+	heading += turn;
+	time = now;
+	SREG = sreg;
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
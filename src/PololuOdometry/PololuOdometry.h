@@ -0,0 +1,113 @@
+/*
+  PololuOdometry.h - Fixed-point differential-drive odometry that integrates
+      wheel encoder counts at a fixed rate from the OrangutanTime interrupt.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef PololuOdometry_h
+#define PololuOdometry_h
+
+// The robot's position and heading.  x and y are in micrometers, and the
+// heading is a binary angle (see PololuFixedMath.h: 65536 units make a full
+// circle), measured counterclockwise from the x axis.  time is the value
+// of get_ms() when the pose was last updated.
+typedef struct OdometryPose
+{
+	long x;
+	long y;
+	unsigned int heading;
+	unsigned long time;
+} OdometryPose;
+
+#ifdef __cplusplus
+
+class PololuOdometry
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	PololuOdometry() { }
+
+	// Starts integrating the counts from PololuWheelEncoders every
+	// period_ms milliseconds, from the OrangutanTime timer interrupt.
+	// The left wheel must be on encoder M1 and the right wheel on M2,
+	// both counting up when the robot drives forward.  um_per_count is
+	// the distance the wheel travels per encoder count, in micrometers,
+	// and wheel_base_mm is the distance between the wheels.  The pose
+	// starts at (0, 0) with a heading of 0.  Choose period_ms so that the
+	// robot travels less than 65 mm per update.  Each update's position
+	// error is about distance * turn^2 / 24 (turn in radians) plus up to
+	// 1/10000 of the distance, e.g. 26 um for a 5 degree turn over 65 mm;
+	// shorter periods make it smaller.
+	//
+	// PololuWheelEncoders::init() must be called first, and nothing else
+	// should read the encoder counts with getCountsAndResetM1/M2().
+	static void init(unsigned int um_per_count, unsigned int wheel_base_mm, unsigned char period_ms);
+
+	// Stops updating the pose.
+	static void stop();
+
+	// Copies the latest pose.  All of the fields come from the same
+	// update.
+	static void getPose(OdometryPose *pose);
+
+	// Moves the robot to the given pose (for example, after it touches a
+	// known landmark).
+	static void setPose(long x, long y, unsigned int heading);
+
+	// Don't call this function.  It is only public so that it can be
+	// registered with OrangutanTime.
+	static void update();
+
+  private:
+
+	static unsigned int umPerCount;
+	static unsigned long headingPerCount;	// fine heading units per count of difference
+	static unsigned char period;
+	static unsigned char msUntilUpdate;
+
+	static long x, y;
+	static unsigned long heading;	// high 16 bits are the binary angle
+	static unsigned long time;
+};
+
+extern "C" {
+#endif // __cplusplus
+
+void odometry_init(unsigned int um_per_count, unsigned int wheel_base_mm, unsigned char period_ms);
+void odometry_stop(void);
+void odometry_get_pose(OdometryPose *pose);
+void odometry_set_pose(long x, long y, unsigned int heading);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
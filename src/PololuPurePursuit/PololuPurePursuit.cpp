@@ -0,0 +1,208 @@
+/*
+  PololuPurePursuit.cpp - Fixed-point pure pursuit path follower for
+      differential-drive robots, using PololuOdometry for the robot's pose.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#include "PololuPurePursuit.h"
+#include "../PololuOdometry/PololuOdometry.h"
+#include "../PololuFixedMath/PololuFixedMath.h"
+#include "../OrangutanScheduler/OrangutanScheduler.h"
+#include "../OrangutanMotors/OrangutanMotors.h"
+
+#include <avr/pgmspace.h>
+#include <stdlib.h>
+
+const Waypoint *PololuPurePursuit::path;
+unsigned char PololuPurePursuit::inProgramSpace;
+unsigned char PololuPurePursuit::count = 0;
+unsigned char PololuPurePursuit::target;
+unsigned int PololuPurePursuit::lookahead;
+unsigned int PololuPurePursuit::wheelBase;
+unsigned int PololuPurePursuit::arrival;
+unsigned int PololuPurePursuit::period;
+int PololuPurePursuit::speed;
+
+extern "C" void pure_pursuit_init(unsigned int lookahead_mm, unsigned int wheel_base_mm, int speed,
+	unsigned int arrival_mm, unsigned int period_ms)
+{
+	PololuPurePursuit::init(lookahead_mm, wheel_base_mm, speed, arrival_mm, period_ms);
+}
+
+extern "C" void pure_pursuit_follow(const Waypoint *path, unsigned char count)
+{
+	PololuPurePursuit::follow(path, count);
+}
+
+extern "C" void pure_pursuit_follow_from_program_space(const Waypoint *path, unsigned char count)
+{
+	PololuPurePursuit::followFromProgramSpace(path, count);
+}
+
+extern "C" void pure_pursuit_set_speed(int speed)
+{
+	PololuPurePursuit::setSpeed(speed);
+}
+
+extern "C" void pure_pursuit_stop()
+{
+	PololuPurePursuit::stop();
+}
+
+extern "C" unsigned char pure_pursuit_is_done()
+{
+	return PololuPurePursuit::isDone();
+}
+
+extern "C" unsigned char pure_pursuit_get_target()
+{
+	return PololuPurePursuit::getTarget();
+}
+
+extern "C" void pure_pursuit_update()
+{
+	PololuPurePursuit::update();
+}
+
+void PololuPurePursuit::init(unsigned int lookahead_mm, unsigned int wheel_base_mm, int new_speed,
+	unsigned int arrival_mm, unsigned int period_ms)
+{
+	lookahead = lookahead_mm;
+	wheelBase = wheel_base_mm;
+	speed = new_speed;
+	arrival = arrival_mm;
+	period = period_ms;
+}
+
+void PololuPurePursuit::follow(const Waypoint *new_path, unsigned char new_count)
+{
+	start(new_path, new_count, 0);
+}
+
+void PololuPurePursuit::followFromProgramSpace(const Waypoint *new_path, unsigned char new_count)
+{
+	start(new_path, new_count, 1);
+}
+
+void PololuPurePursuit::start(const Waypoint *new_path, unsigned char new_count, unsigned char program_space)
+{
+	path = new_path;
+	inProgramSpace = program_space;
+	target = 0;
+	count = new_count;
+
+	if (count)
+		OrangutanScheduler::addTask(update, period, 1);
+}
+
+void PololuPurePursuit::stop()
+{
+	count = 0;
+	OrangutanScheduler::removeTask(update);
+	OrangutanMotors::setSpeeds(0, 0);
+}
+
+void PololuPurePursuit::getWaypoint(unsigned char index, Waypoint *waypoint)
+{
+	if (inProgramSpace)
+		memcpy_P(waypoint, &path[index], sizeof(Waypoint));
+	else
+		*waypoint = path[index];
+}
+
+void PololuPurePursuit::update()
+{
+	if (count == 0)
+		return;
+
+	OdometryPose pose;
+	PololuOdometry::getPose(&pose);
+	long x = pose.x / 1000;	// micrometers to millimeters
+	long y = pose.y / 1000;
+
+	// Advance to the first waypoint that is at least one lookahead
+	// distance away (or the last one).
+	long dx, dy;
+	unsigned long distance;
+	while (1)
+	{
+		Waypoint waypoint;
+		getWaypoint(target, &waypoint);
+		dx = waypoint.x - x;
+		dy = waypoint.y - y;
+
+		// Scale the vector to the goal down to 16 bits for hypot and
+		// atan2; this only loses precision when it is over 32 m long.
+		unsigned char shift = 0;
+		while (dx > 32767 || dx < -32767 || dy > 32767 || dy < -32767)
+		{
+			dx >>= 1;
+			dy >>= 1;
+			shift++;
+		}
+		distance = (unsigned long)PololuFixedMath::hypot(dx, dy) << shift;
+
+		if (distance >= lookahead || target == count - 1)
+			break;
+		target++;
+	}
+
+	if (target == count - 1 && distance <= arrival)
+	{
+		stop();
+		return;
+	}
+
+	// Angle between the robot's heading and the goal.  The arc through
+	// the goal has curvature 2 sin(alpha) / distance, so the wheel speeds
+	// differ from the center speed by speed * wheelBase * sin(alpha) /
+	// distance; steering is that ratio in Q14 format.
+	unsigned int alpha = PololuFixedMath::atan2(dy, dx) - pose.heading;
+	long steering = ((long)wheelBase * PololuFixedMath::sin(alpha) >> 1) / (long)(distance ? distance : 1);
+	if (steering > 16384)
+		steering = 16384;	// pivot on the inner wheel, at most
+	else if (steering < -16384)
+		steering = -16384;
+
+	int turn = ((long)speed * steering) >> 14;
+	int left = speed - turn;
+	int right = speed + turn;
+
+	// The outer wheel can need up to twice the center speed.  If that is
+	// more than the motors take, slow both wheels by the same factor so
+	// the robot still follows the same arc.
+	int fastest = abs(left) > abs(right) ? abs(left) : abs(right);
+	if (fastest > 255)
+	{
+		left = (long)left * 255 / fastest;
+		right = (long)right * 255 / fastest;
+	}
+	OrangutanMotors::setSpeeds(left, right);
+}
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
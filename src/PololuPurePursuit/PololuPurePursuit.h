@@ -0,0 +1,124 @@
+/*
+  PololuPurePursuit.h - Fixed-point pure pursuit path follower for
+      differential-drive robots, using PololuOdometry for the robot's pose.
+*/
+
+
+/*
+ * Written by Pololu Corporation.
+ * Copyright (c) 2012 Pololu Corporation. For more information, see
+ *
+ *   http://www.pololu.com
+ *   http://forum.pololu.com
+ *   http://www.pololu.com/docs/0J18
+ *
+ * You may freely modify and share this code, as long as you keep this
+ * notice intact (including the two links above).  Licensed under the
+ * Creative Commons BY-SA 3.0 license:
+ *
+ *   http://creativecommons.org/licenses/by-sa/3.0/
+ *
+ * Disclaimer: To the extent permitted by law, Pololu provides this work
+ * without any warranty.  It might be defective, in which case you agree
+ * to be responsible for all resulting costs and damages.
+ */
+
+
+#ifndef PololuPurePursuit_h
+#define PololuPurePursuit_h
+
+// A point on the path, in millimeters, in the same coordinate system as
+// PololuOdometry.
+typedef struct Waypoint
+{
+	int x;
+	int y;
+} Waypoint;
+
+#ifdef __cplusplus
+
+class PololuPurePursuit
+{
+  public:
+
+	// Constructor (doesn't do anything).
+	PololuPurePursuit() { }
+
+	// Sets up the follower.  Each update, the robot steers along the arc
+	// that reaches the first waypoint that is at least lookahead_mm
+	// away, so waypoints should be spaced more closely than that.
+	// wheel_base_mm is the distance between the wheels, speed is the
+	// motor speed (as for OrangutanMotors::setSpeeds()) of the center of
+	// the robot, and the robot stops when it is within arrival_mm of the
+	// last waypoint.  The follower runs as an OrangutanScheduler task
+	// every period_ms milliseconds once a path is given to follow().
+	static void init(unsigned int lookahead_mm, unsigned int wheel_base_mm, int speed,
+		unsigned int arrival_mm, unsigned int period_ms);
+
+	// Starts following a path of count waypoints in RAM.  The path must
+	// stay valid until the robot arrives.
+	static void follow(const Waypoint *path, unsigned char count);
+
+	// Starts following a path of count waypoints in program space.
+	static void followFromProgramSpace(const Waypoint *path, unsigned char count);
+
+	// Changes the speed while following a path.
+	static inline void setSpeed(int new_speed) { speed = new_speed; }
+
+	// Stops the motors and stops following the path.
+	static void stop();
+
+	// Returns 1 if the robot has reached the end of the path (or stop()
+	// was called), 0 if it is still following it.
+	static inline unsigned char isDone() { return count == 0; }
+
+	// Returns the index of the waypoint the robot is currently heading
+	// for.
+	static inline unsigned char getTarget() { return target; }
+
+	// Runs one control step: reads the pose, picks the goal waypoint and
+	// sets the motor speeds.  This is the OrangutanScheduler task; you
+	// only need to call it yourself if you do not use the scheduler.
+	static void update();
+
+  private:
+
+	static const Waypoint *path;
+	static unsigned char inProgramSpace;
+	static unsigned char count;		// 0 when not following a path
+	static unsigned char target;
+	static unsigned int lookahead;
+	static unsigned int wheelBase;
+	static unsigned int arrival;
+	static unsigned int period;
+	static int speed;
+
+	static void start(const Waypoint *new_path, unsigned char new_count, unsigned char program_space);
+	static void getWaypoint(unsigned char index, Waypoint *waypoint);
+};
+
+extern "C" {
+#endif // __cplusplus
+
+void pure_pursuit_init(unsigned int lookahead_mm, unsigned int wheel_base_mm, int speed,
+	unsigned int arrival_mm, unsigned int period_ms);
+void pure_pursuit_follow(const Waypoint *path, unsigned char count);
+void pure_pursuit_follow_from_program_space(const Waypoint *path, unsigned char count);
+void pure_pursuit_set_speed(int speed);
+void pure_pursuit_stop(void);
+unsigned char pure_pursuit_is_done(void);
+unsigned char pure_pursuit_get_target(void);
+void pure_pursuit_update(void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+// Local Variables: **
+// mode: C++ **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **
@@ -53,6 +53,7 @@
 
 #ifndef ARDUINO
 #include "../OrangutanTime/OrangutanTime.h"		// provides access to delay routines
+#include "../OrangutanProfiler/OrangutanProfiler.h"
 #else
 #include <Arduino.h> // provides access to delay() and delayMicroseconds()
 #endif
@@ -106,6 +107,11 @@ extern "C" void qtr_read_calibrated(unsigned int *sensor_values, unsigned char r
 	qtr->readCalibrated(sensor_values, readMode);
 }
 
+extern "C" unsigned char qtr_read_calibrated_frame(unsigned char *frame, unsigned char format, unsigned char readMode)
+{
+	return qtr->readCalibratedFrame(frame, format, readMode);
+}
+
 extern "C" unsigned int qtr_read_line(unsigned int *sensor_values, unsigned char readMode)
 {
 	return qtr->readLine(sensor_values, readMode, false);
@@ -121,6 +127,16 @@ extern "C" void qtr_reset_calibration()
 	qtr->resetCalibration();
 }
 
+extern "C" void qtr_set_adaptive_timeout(unsigned char enable)
+{
+	qtr->setAdaptiveTimeout(enable);
+}
+
+extern "C" void qtr_set_online_calibration(unsigned char shift)
+{
+	qtr->setOnlineCalibration(shift);
+}
+
 extern "C" unsigned int *qtr_calibrated_minimum_on()
 {
 	return qtr->calibratedMinimumOn;
@@ -157,6 +173,9 @@ void PololuQTRSensors::init(unsigned char numSensors,
 		_numSensors = numSensors;
 		
 	_type = type;
+	_adaptiveTimeout = 0;
+	_onlineCalibrationShift = 0;
+	_calibrationDither = 0;
 
 	struct IOStruct emitterIO;
 	OrangutanDigital::getIORegisters(&emitterIO, emitterPin);
@@ -184,10 +203,13 @@ void PololuQTRSensors::read(unsigned int *sensor_values, unsigned char readMode)
 
 	if (_type == QTR_RC)
 	{
-		((PololuQTRSensorsRC*)this)->readPrivate(sensor_values);
+		// an emitters-off reading is compared against the off calibration
+		unsigned int *calibratedMaximum = (readMode == QTR_EMITTERS_OFF) ?
+			calibratedMaximumOff : calibratedMaximumOn;
+		((PololuQTRSensorsRC*)this)->readPrivate(sensor_values, readTimeout(calibratedMaximum));
 		emittersOff();
 		if(readMode == QTR_EMITTERS_ON_AND_OFF)
-			((PololuQTRSensorsRC*)this)->readPrivate(off_values);
+			((PololuQTRSensorsRC*)this)->readPrivate(off_values, readTimeout(calibratedMaximumOff));
 	}
 	else
 	{
@@ -207,6 +229,28 @@ void PololuQTRSensors::read(unsigned int *sensor_values, unsigned char readMode)
 }
 
 
+// Returns the adaptive QTR-RC timeout: the largest calibrated maximum plus
+// 25%, or the full timeout if adaptive timeouts are disabled, there is no
+// calibration yet, or the result would exceed the full timeout.
+unsigned int PololuQTRSensors::readTimeout(unsigned int *calibratedMaximum)
+{
+	if (!_adaptiveTimeout || !calibratedMaximum)
+		return _maxValue;
+
+	unsigned char i;
+	unsigned int limit = 0;
+	for(i=0;i<_numSensors;i++)
+	{
+		if (calibratedMaximum[i] > limit)
+			limit = calibratedMaximum[i];
+	}
+
+	if (limit == 0 || limit >= _maxValue - (limit >> 2))
+		return _maxValue;
+	return limit + (limit >> 2);
+}
+
+
 // Turn the IR LEDs off and on.  This is mainly for use by the
 // read method, and calling these functions before or
 // after the reading the sensors will have no effect on the
@@ -306,6 +350,10 @@ void PololuQTRSensors::calibrateOnOrOff(unsigned int **calibratedMinimum,
 			(*calibratedMinimum)[i] = _maxValue;
 	}
 
+	// calibration has to see the full range of values
+	unsigned char adaptiveTimeout = _adaptiveTimeout;
+	_adaptiveTimeout = 0;
+
 	int j;
 	for(j=0;j<10;j++)
 	{
@@ -322,6 +370,8 @@ void PololuQTRSensors::calibrateOnOrOff(unsigned int **calibratedMinimum,
 		}
 	}
 
+	_adaptiveTimeout = adaptiveTimeout;
+
 	// record the min and max calibration values
 	for(i=0;i<_numSensors;i++)
 	{
@@ -333,26 +383,130 @@ void PololuQTRSensors::calibrateOnOrOff(unsigned int **calibratedMinimum,
 }
 
 
+// Returns gap >> shift, rounded up with a probability equal to the
+// fraction shifted out, so that the average step is exactly gap / 2^shift
+// even when that is much less than one count.  The threshold comes from a
+// Weyl sequence, which covers 0 - 2^shift-1 evenly.
+inline unsigned int PololuQTRSensors::decayStep(unsigned int gap, unsigned char shift)
+{
+	_calibrationDither += 40503;	// 65536 / golden ratio
+	unsigned int fraction = gap & ((1U << shift) - 1);
+	unsigned int threshold = (_calibrationDither & 0xFFFF) >> (16 - shift);
+	return (gap >> shift) + (fraction > threshold);
+}
+
+
+// Online recalibration: moves each sensor's calibrated minimum and maximum
+// towards the raw reading, quickly when the reading is outside the range
+// and slowly (decay) when it is inside, ignoring readings far outside it.
+void PololuQTRSensors::updateCalibration(unsigned int *sensor_values,
+										 unsigned int *calibratedMinimum,
+										 unsigned int *calibratedMaximum)
+{
+	unsigned char i;
+	unsigned char shift = _onlineCalibrationShift;
+	unsigned char decayShift = shift + 6;
+	if(decayShift > 15)
+		decayShift = 15;	// decayStep() works in 16 bits
+	unsigned int minRange = _maxValue >> 3;
+
+	for(i=0;i<_numSensors;i++)
+	{
+		unsigned int value = sensor_values[i];
+		unsigned int calmin = calibratedMinimum[i];
+		unsigned int calmax = calibratedMaximum[i];
+
+		if(calmax <= calmin) // not calibrated
+			continue;
+		unsigned int range = calmax - calmin;
+
+		if(value < calmin)
+		{
+			if(calmin - value > range/2) // outlier
+				continue;
+			calmin -= ((calmin - value) >> shift) + 1;
+		}
+		else if(value > calmax)
+		{
+			if(value - calmax > range/2) // outlier
+				continue;
+			calmax += ((value - calmax) >> shift) + 1;
+		}
+		else if(range > minRange)
+		{
+			calmin += decayStep(value - calmin, decayShift);
+			calmax -= decayStep(calmax - value, decayShift);
+		}
+
+		calibratedMinimum[i] = calmin;
+		calibratedMaximum[i] = calmax;
+	}
+}
+
+
 // Returns values calibrated to a value between 0 and 1000, where
 // 0 corresponds to the minimum value read by calibrate() and 1000
 // corresponds to the maximum value.  Calibration values are
 // stored separately for each sensor, so that differences in the
 // sensors are accounted for automatically.
 void PololuQTRSensors::readCalibrated(unsigned int *sensor_values, unsigned char readMode)
+{
+	readCalibratedPrivate(sensor_values, 0, 0, readMode);
+}
+
+
+// Stores calibrated values scaled to 0 - 255 (QTR_FRAME_8BIT) or packed
+// two per byte as 0 - 15 (QTR_FRAME_4BIT, low nibble first).  Returns
+// the number of bytes written, or 0 if not calibrated.
+unsigned char PololuQTRSensors::readCalibratedFrame(unsigned char *frame,
+	unsigned char format, unsigned char readMode)
+{
+	unsigned int sensor_values[QTR_MAX_SENSORS];
+
+	if(format != QTR_FRAME_4BIT)
+		format = QTR_FRAME_8BIT;
+	if(!readCalibratedPrivate(sensor_values, frame, format, readMode))
+		return 0;
+	return format == QTR_FRAME_4BIT ? (_numSensors + 1) >> 1 : _numSensors;
+}
+
+
+// The calibration kernel shared by readCalibrated() and
+// readCalibratedFrame().  Each reading is scaled directly to the range
+// of the requested output, so packed frames take no second pass and
+// lose no more precision than their size requires.
+unsigned char PololuQTRSensors::readCalibratedPrivate(unsigned int *sensor_values,
+	unsigned char *frame, unsigned char format, unsigned char readMode)
 {
 	int i;
+	unsigned int scale;
 
 	// if not calibrated, do nothing
 	if(readMode == QTR_EMITTERS_ON_AND_OFF || readMode == QTR_EMITTERS_OFF)
 		if(!calibratedMinimumOff || !calibratedMaximumOff)
-			return;
+			return 0;
 	if(readMode == QTR_EMITTERS_ON_AND_OFF || readMode == QTR_EMITTERS_ON)
 		if(!calibratedMinimumOn || !calibratedMaximumOn)
-			return;
+			return 0;
+
+	if(format == QTR_FRAME_8BIT)
+		scale = 255;
+	else if(format == QTR_FRAME_4BIT)
+		scale = 15;
+	else
+		scale = 1000;
 
 	// read the needed values
 	read(sensor_values,readMode);
 
+	if(_onlineCalibrationShift)
+	{
+		if(readMode == QTR_EMITTERS_ON)
+			updateCalibration(sensor_values, calibratedMinimumOn, calibratedMaximumOn);
+		else if(readMode == QTR_EMITTERS_OFF)
+			updateCalibration(sensor_values, calibratedMinimumOff, calibratedMaximumOff);
+	}
+
 	for(i=0;i<_numSensors;i++)
 	{
 		unsigned int calmin,calmax;
@@ -388,14 +542,26 @@ void PololuQTRSensors::readCalibrated(unsigned int *sensor_values, unsigned char
 		signed int x = 0;
 		if(denominator != 0)
 			x = (((signed long)sensor_values[i]) - calmin)
-				* 1000 / denominator;
+				* scale / denominator;
 		if(x < 0)
 			x = 0;
-		else if(x > 1000)
-			x = 1000;
-		sensor_values[i] = x;
+		else if(x > (signed int)scale)
+			x = scale;
+
+		if(format == QTR_FRAME_8BIT)
+			frame[i] = x;
+		else if(format == QTR_FRAME_4BIT)
+		{
+			if(i & 1)
+				frame[i >> 1] |= x << 4;
+			else
+				frame[i >> 1] = x;
+		}
+		else
+			sensor_values[i] = x;
 	}
 
+	return 1;
 }
 
 
@@ -549,14 +715,22 @@ void PololuQTRSensorsRC::init(unsigned char* pins,
 // sensors.read(sensor_values);
 // ...
 // The values returned are in microseconds and range from 0 to
-// timeout_us (as specified in the constructor).
-void PololuQTRSensorsRC::readPrivate(unsigned int *sensor_values)
+// timeout_us (as specified in the constructor).  The read ends as soon as
+// every sensor has discharged, or after timeout counts.
+void PololuQTRSensorsRC::readPrivate(unsigned int *sensor_values, unsigned int timeout)
 {
+#ifndef ARDUINO
+	PROFILE_SCOPE(qtr_read_rc);
+#endif
+
 	unsigned char i;
 	unsigned char last_time;
 	unsigned char delta_time;
 	unsigned int time = 0;
 
+	// bit i is set while sensor i has not discharged yet
+	unsigned int pending = (_numSensors >= 16) ? 0xFFFF : (1U << _numSensors) - 1;
+
 	#ifdef _ORANGUTAN_XX4
 	unsigned char last_a = _portAMask;
     #endif
@@ -609,7 +783,7 @@ void PololuQTRSensorsRC::readPrivate(unsigned int *sensor_values)
 						// this is compatible with OrangutanMotors
 
 	last_time = TCNT2;
-	while (time < _maxValue)
+	while (pending && time < timeout)
 	{
 		// Keep track of the total time.
 		// This implicitly casts the difference to unsigned char, so
@@ -636,15 +810,18 @@ void PololuQTRSensorsRC::readPrivate(unsigned int *sensor_values)
 		// figure out which pins changed
 		for (i = 0; i < _numSensors; i++)
 		{
-			if (sensor_values[i] == 0 && !(*_register[i] & _bitmask[i]))
+			if ((pending & (1U << i)) && !(*_register[i] & _bitmask[i]))
+			{
 				sensor_values[i] = time;
+				pending &= ~(1U << i);
+			}
 		}
 	}
 
 	TCCR2A = prevTCCR2A;
 	TCCR2B = prevTCCR2B;
 	for(i = 0; i < _numSensors; i++)
-		if (!sensor_values[i])
+		if (pending & (1U << i))
 			sensor_values[i] = _maxValue;
 }
 
@@ -724,6 +901,10 @@ void PololuQTRSensorsAnalog::init(unsigned char* analogPins,
 // reflectance (e.g. a black surface or a void).
 void PololuQTRSensorsAnalog::readPrivate(unsigned int *sensor_values)
 {
+#ifndef ARDUINO
+	PROFILE_SCOPE(qtr_read_analog);
+#endif
+
 	unsigned char i, j;
 	
 	// store current state of various registers
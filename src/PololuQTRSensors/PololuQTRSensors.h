@@ -42,6 +42,10 @@
 #define QTR_EMITTERS_ON 1
 #define QTR_EMITTERS_ON_AND_OFF 2
 
+// Formats for readCalibratedFrame().
+#define QTR_FRAME_8BIT 8
+#define QTR_FRAME_4BIT 4
+
 #ifdef __cplusplus
 
 #define QTR_MAX_SENSORS 16
@@ -86,6 +90,31 @@ class PololuQTRSensors
 	// Resets all calibration that has been done.
 	void resetCalibration();
 
+	// QTR-RC sensors only: when enabled, each read stops waiting for the
+	// sensors to discharge at 1.25 times the largest calibrated maximum
+	// instead of the full timeout given to init(), so reads get faster
+	// on brighter surfaces.  Sensors that have not discharged by then
+	// read as the full timeout, which readCalibrated() reports as 1000
+	// just as before.  Has no effect until calibrate() has been called,
+	// and calibrate() always uses the full timeout.  Disabled by default.
+	void setAdaptiveTimeout(unsigned char enable) { _adaptiveTimeout = enable; }
+
+	// Turns online recalibration on (shift = 1 - 8) or off (shift = 0,
+	// the default).  While it is on, every readCalibrated() (and so every
+	// readLine()) with QTR_EMITTERS_ON or QTR_EMITTERS_OFF also folds the
+	// raw readings into the calibration, so it follows changes in
+	// lighting or surface during a run.  A reading outside a sensor's
+	// calibrated range pulls that end of the range 1/2^shift of the way
+	// towards it; a reading inside the range lets both ends decay 64
+	// times more slowly towards it (on average; steps of less than one
+	// count are taken now and then), so extremes that are no longer seen
+	// are gradually forgotten (but the range never shrinks below 1/8 of
+	// the timeout or ADC range).  Readings more than half the range
+	// beyond either end are ignored as glitches.  calibrate() must have
+	// been called first.  Values of 4 - 6 work well when reading every
+	// few milliseconds.
+	void setOnlineCalibration(unsigned char shift) { _onlineCalibrationShift = shift; }
+
 	// Returns values calibrated to a value between 0 and 1000, where
 	// 0 corresponds to the minimum value read by calibrate() and 1000
 	// corresponds to the maximum value.  Calibration values are
@@ -93,6 +122,19 @@ class PololuQTRSensors
 	// sensors are accounted for automatically.
 	void readCalibrated(unsigned int *sensor_values, unsigned char readMode = QTR_EMITTERS_ON);
 
+	// Works like readCalibrated(), but stores the calibrated values in
+	// a compact frame for logging, telemetry or EEPROM.  With
+	// QTR_FRAME_8BIT each sensor takes one byte from 0 to 255; with
+	// QTR_FRAME_4BIT each takes four bits from 0 to 15, two sensors per
+	// byte with the lower-numbered sensor in the low nibble.  The values
+	// are scaled straight from the raw readings, so they are no coarser
+	// than they need to be.  There must be space in frame for
+	// numSensors bytes (8-bit) or (numSensors + 1) / 2 bytes (4-bit).
+	// Returns the number of bytes written, or 0 if the sensors have not
+	// been calibrated for readMode.
+	unsigned char readCalibratedFrame(unsigned char *frame,
+		unsigned char format = QTR_FRAME_8BIT, unsigned char readMode = QTR_EMITTERS_ON);
+
 	// Operates the same as read calibrated, but also returns an
 	// estimated position of the robot with respect to a line. The
 	// estimate is made using a weighted average of the sensor indices
@@ -152,6 +194,10 @@ class PololuQTRSensors
 	
 	unsigned int _maxValue; // the maximum value returned by this function
 
+	unsigned char _adaptiveTimeout;	// boolean
+	unsigned char _onlineCalibrationShift;	// 0 = off
+	unsigned int _calibrationDither;	// rounds the online calibration decay
+
   private:
 	
 	unsigned char _type;	// the type of the derived class (QTR_RC
@@ -163,6 +209,24 @@ class PololuQTRSensors
 	void calibrateOnOrOff(unsigned int **calibratedMinimum,
 						  unsigned int **calibratedMaximum,
 						  unsigned char readMode);
+
+	// Returns how long a QTR-RC read should wait, in timer2 counts, given
+	// the calibrated maximums for the emitter state being read.
+	unsigned int readTimeout(unsigned int *calibratedMaximum);
+
+	// Reads the sensors and scales each value to 0 - scale using the
+	// calibration for readMode.  The results go to sensor_values when
+	// format is 0, otherwise they are packed into frame.  Returns 0 if
+	// the sensors have not been calibrated for readMode.
+	unsigned char readCalibratedPrivate(unsigned int *sensor_values,
+		unsigned char *frame, unsigned char format, unsigned char readMode);
+
+	// Folds raw readings into the given calibration arrays (online
+	// recalibration).
+	void updateCalibration(unsigned int *sensor_values,
+						   unsigned int *calibratedMinimum,
+						   unsigned int *calibratedMaximum);
+	inline unsigned int decayStep(unsigned int gap, unsigned char shift);
 };
 
 
@@ -235,7 +299,9 @@ class PololuQTRSensorsRC : public PololuQTRSensors
 	// with higher values corresponding to lower reflectance (e.g. a black
 	// surface or a void).  Timer2 will be running at the MCU clock / 8, which
 	// means 2 MHz for a 16 MHz MCU and 2.5 MHz for a 20 MHz MCU.
-	void readPrivate(unsigned int *sensor_values);
+	// Sensors that have not discharged after timeout counts read as the
+	// full timeout (_maxValue).
+	void readPrivate(unsigned int *sensor_values, unsigned int timeout);
  
 
   private:
@@ -338,7 +404,10 @@ void qtr_emitters_off(void);
 void qtr_read(unsigned int *sensor_values, unsigned char readMode);
 void qtr_calibrate(unsigned char readMode);
 void qtr_reset_calibration(void);
+void qtr_set_adaptive_timeout(unsigned char enable);
+void qtr_set_online_calibration(unsigned char shift);
 void qtr_read_calibrated(unsigned int *sensor_values, unsigned char readMode);
+unsigned char qtr_read_calibrated_frame(unsigned char *frame, unsigned char format, unsigned char readMode);
 unsigned int qtr_read_line(unsigned int *sensor_values, unsigned char readMode);
 unsigned int qtr_read_line_white(unsigned int *sensor_values, unsigned char readMode);
 
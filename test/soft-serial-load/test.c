@@ -0,0 +1,107 @@
+/*
+ * test.c - Measures the CPU time that OrangutanSoftSerial takes per byte,
+ * on an Orangutan SV-328 or Baby Orangutan B-328, or in simavr.
+ *
+ * Connect IO_D0 (TX) to IO_D1 (RX) with a wire; in simavr, connect the
+ * PD0 output IRQ to the PD1 input IRQ.  The program counts how many
+ * times a short loop runs in one second with no traffic, then while port
+ * 0 sends continuously at BAUD, then while it also receives everything it
+ * sends.  The loops it loses, times the cycles per loop, divided by the
+ * bytes transferred, are the cycles the interrupts took per byte.
+ *
+ * The results are shown on the LCD and left in txCyclesPerByte and
+ * txRxCyclesPerByte for reading with a debugger or from simavr.
+ */
+
+#include <pololu/orangutan.h>
+
+#define BAUD			38400
+#define WINDOW_MS		1000
+
+volatile unsigned long txCyclesPerByte;
+volatile unsigned long txRxCyclesPerByte;
+
+static char message[64];
+static char received[64];
+
+// Runs the counting loop for WINDOW_MS, restarting the transfer whenever
+// it finishes if traffic is on, and returns the loop count.  *bytes is set
+// to the number of bytes sent in the window.
+static unsigned long count_loops(unsigned char traffic, unsigned char receive, unsigned long *bytes)
+{
+	volatile unsigned long loops = 0;
+	unsigned long sent = 0;
+
+	if (traffic)
+	{
+		if (receive)
+			soft_serial_receive_ring(0, received, sizeof(received));
+		soft_serial_send(0, message, sizeof(message));
+	}
+
+	unsigned long start = get_ms();
+	while (get_ms() - start < WINDOW_MS)
+	{
+		loops++;
+		if (traffic && soft_serial_send_buffer_empty(0))
+		{
+			sent += sizeof(message);
+			soft_serial_send(0, message, sizeof(message));
+		}
+	}
+	if (traffic)
+		sent += soft_serial_get_sent_bytes(0);
+
+	soft_serial_cancel_receive(0);
+	while (!soft_serial_send_buffer_empty(0))
+		;
+
+	*bytes = sent;
+	return loops;
+}
+
+static unsigned long cycles_per_byte(unsigned long idle_loops, unsigned long busy_loops, unsigned long bytes)
+{
+	if (bytes == 0 || busy_loops >= idle_loops)
+		return 0;
+
+	// cycles per loop = F_CPU * WINDOW_MS / 1000 / idle_loops
+	unsigned long long lost = (unsigned long long)(idle_loops - busy_loops) * (F_CPU / 1000) * WINDOW_MS;
+	return lost / idle_loops / bytes;
+}
+
+int main()
+{
+	unsigned long bytes, idle, busy;
+
+	for (unsigned char i = 0; i < sizeof(message); i++)
+		message[i] = 'A' + (i % 26);
+
+	soft_serial_init(0, IO_D1, IO_D0);
+	soft_serial_set_baud_rate(0, BAUD);
+
+	idle = count_loops(0, 0, &bytes);
+
+	busy = count_loops(1, 0, &bytes);
+	txCyclesPerByte = cycles_per_byte(idle, busy, bytes);
+
+	busy = count_loops(1, 1, &bytes);
+	txRxCyclesPerByte = cycles_per_byte(idle, busy, bytes);
+
+	clear();
+	print("TX ");
+	print_unsigned_long(txCyclesPerByte);
+	lcd_goto_xy(0, 1);
+	print("RX ");
+	print_unsigned_long(txRxCyclesPerByte - txCyclesPerByte);
+
+	while (1)
+		;
+}
+
+// Local Variables: **
+// mode: C **
+// c-basic-offset: 4 **
+// tab-width: 4 **
+// indent-tabs-mode: t **
+// end: **